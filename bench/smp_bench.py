@@ -0,0 +1,96 @@
+import re
+import statistics
+import subprocess
+import time
+
+# --- Configuration ---
+AI_EXECUTABLE_PATH = "./bin/filipbot"
+FEN_CONFIG_FILE = "bench/fen_benchmarks.txt"  # File containing FENs for benchmarking
+THREAD_COUNTS = [1, 2, 4, 8, 16]  # Values sent with "setoption name Threads value <n>"
+NUM_RUNS = 3  # Number of searches per FEN and thread count
+REMAINING_TIME_MS = 100000  # Remaining time sent with go. The engine uses a fraction of it per move.
+
+# The search prints info lines that look like:
+# info depth 7 score cp 31 time 1203 nodes 2391241 nps 1987731 hashfull 45 pv ...
+OUTPUT_PATTERN = r"\bnps\s+(\d+)"
+
+
+def load_fen_configs():
+    """Loads FEN strings from the configuration file, skipping empty lines and comments."""
+    with open(FEN_CONFIG_FILE, "r") as f:
+        fens = [line.strip() for line in f if line.strip() and not line.strip().startswith("#")]
+    if not fens:
+        print(f"Error: No FEN strings found in {FEN_CONFIG_FILE}.")
+        exit(1)
+    print(f"Loaded {len(fens)} FENs from {FEN_CONFIG_FILE}.")
+    return fens
+
+
+def send(process, command):
+    process.stdin.write(command + "\n")
+    process.stdin.flush()
+
+
+def search_nps(process, fen):
+    """Searches fen once and returns the nps of the last info line before bestmove."""
+    send(process, f"position fen {fen}")
+    send(process, f"go wtime {REMAINING_TIME_MS} btime {REMAINING_TIME_MS}")
+    nps = None
+    TIMEOUT = 120
+    start_time = time.time()
+    while (time.time() - start_time) < TIMEOUT:
+        if process.poll() is not None:
+            raise RuntimeError("AI process exited unexpectedly during run.")
+        line = process.stdout.readline().strip()
+        if line.startswith("bestmove"):
+            return nps
+        match = re.search(OUTPUT_PATTERN, line)
+        if match:
+            nps = int(match.group(1))
+    raise RuntimeError(f"AI did not return a bestmove within {TIMEOUT}s for FEN: {fen}")
+
+
+def run_smp_test(fens):
+    """Returns {threads: [nps_run1, nps_run2, ...]} over all FENs."""
+    results = {}
+    process = subprocess.Popen(
+        [AI_EXECUTABLE_PATH],
+        stdin=subprocess.PIPE,
+        stdout=subprocess.PIPE,
+        stderr=subprocess.STDOUT,
+        text=True,
+        bufsize=1,
+    )
+    try:
+        for threads in THREAD_COUNTS:
+            send(process, f"setoption name Threads value {threads}")
+            results[threads] = []
+            for fen_idx, fen in enumerate(fens):
+                for run_idx in range(1, NUM_RUNS + 1):
+                    print(f"Threads {threads}, FEN {fen_idx + 1}/{len(fens)}, Run {run_idx}/{NUM_RUNS}...", end="\r")
+                    nps = search_nps(process, fen)
+                    if nps is not None:
+                        results[threads].append(nps)
+        print()
+    finally:
+        if process.poll() is None:
+            send(process, "quit")
+            try:
+                process.wait(timeout=5)
+            except subprocess.TimeoutExpired:
+                process.terminate()
+    return results
+
+
+def print_report(results):
+    base = statistics.mean(results[THREAD_COUNTS[0]])
+    print(f"{'threads':>8} {'avg nps':>12} {'stdev':>10} {'speedup':>8} {'efficiency':>10}")
+    for threads, samples in results.items():
+        mean = statistics.mean(samples)
+        stdev = statistics.stdev(samples) if len(samples) >= 2 else 0
+        speedup = mean / base
+        print(f"{threads:>8} {int(mean):>12} {int(stdev):>10} {speedup:>8.2f} {speedup / threads:>10.2f}")
+
+
+if __name__ == "__main__":
+    print_report(run_smp_test(load_fen_configs()))
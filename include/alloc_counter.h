@@ -0,0 +1,16 @@
+// Copyright 2025 Filip Agert
+#ifndef ALLOC_COUNTER_H
+#define ALLOC_COUNTER_H
+#include <cstdint>
+
+/**
+ * @brief Counts heap allocations per thread. The global operator new is replaced to count every
+ * allocation, so code that should not allocate, like the search, can be checked.
+ */
+namespace alloc_counter {
+/**
+ * @brief Number of allocations made by the calling thread since it started.
+ */
+uint64_t thread_allocations();
+}  // namespace alloc_counter
+#endif
@@ -7,13 +7,17 @@
 #include <cassert>
 #include <constants.h>
 #include <move.h>
+#include <nnue.h>
 #include <notation_interface.h>
 #include <piece.h>
+#include <psqt.h>
 #include <stdexcept>
+#include <zobrist.h>
 
 #include <array>
 #include <cstdint>
 #include <string>
+#include <type_traits>
 
 struct restore_move_info {
     uint8_t ply_moves = 0;
@@ -21,8 +25,33 @@ struct restore_move_info {
     uint8_t castleinfo = 0;
     Piece_t captured = 0;
 };
+/**
+ * @brief A position without the mailbox and the network accumulator, for copy-make: the bitboards
+ * and the incrementally updated state. Board::restore copies it back and rebuilds the few mailbox
+ * squares the move touched from the bitboards.
+ */
+struct position_snapshot {
+    BB white_rooks, white_pawns, white_knights, white_bishops, white_queen, white_king, white_pieces;
+    BB black_rooks, black_pawns, black_knights, black_bishops, black_queen, black_king, black_pieces;
+    uint64_t hash;
+    uint64_t pawn_hash;
+    int full_moves;
+    int mg_score;
+    int eg_score;
+    int phase;
+    uint8_t castleinfo;
+    uint8_t turn_color;
+    uint8_t en_passant_square;
+    uint8_t check;
+    uint8_t ply_moves;
+    bool en_passant;
+};
+static_assert(std::is_trivially_copyable_v<position_snapshot> && sizeof(position_snapshot) <= 192, "Snapshots are copied at every node");
+static_assert(sizeof(Piece) == 1, "The mailbox is meant to be one byte per square");
 struct Board {
  private:
+    // Piece on each square, kept next to the bitboards. Piece lookups in do_move and move ordering are a
+    // single byte load this way, scanning the bitboards instead made search about 10% slower.
     std::array<Piece, 64> game_board;
     BB white_rooks, white_pawns, white_knights, white_bishops, white_queen, white_king, white_pieces;
     BB black_rooks, black_pawns, black_knights, black_bishops, black_queen, black_king, black_pieces;
@@ -33,6 +62,15 @@ struct Board {
     uint8_t check = 0;  // 0 For no check, white for white checked, black for black checked.
     uint8_t ply_moves;
     bool en_passant = false;
+    uint64_t hash = 0;       // Zobrist hash. Updated incrementally by the add/remove/move piece functions and do/undo move.
+    uint64_t pawn_hash = 0;  // Zobrist hash of the pawns only. Keys the pawn structure cache.
+    // Sums of psqt::table over all pieces, white positive, and the game phase. Updated by the add/remove/move piece functions.
+    int mg_score = 0;
+    int eg_score = 0;
+    int phase = 0;
+#ifdef USE_NNUE
+    nnue::accumulator acc;  // Only kept up to date while nnue::enabled. Built with make nnue=1.
+#endif
     // Color                 W          B
     // Bitboards: Pieces: [9-14]   [17-22].
     //            Attack: 15         23
@@ -48,6 +86,20 @@ struct Board {
     uint8_t get_castling() const { return castleinfo; }
     int get_full_moves() const { return full_moves; }
     uint8_t get_check() const { return check; }
+    uint64_t get_hash() const { return hash; }
+    uint64_t get_pawn_hash() const { return pawn_hash; }
+    int get_mg_score() const { return mg_score; }
+    int get_eg_score() const { return eg_score; }
+    int get_phase() const { return phase; }
+#ifdef USE_NNUE
+    const nnue::accumulator &get_accumulator() const { return acc; }
+    void set_accumulator(const nnue::accumulator &a) { acc = a; }
+#endif
+    /**
+     * @brief Recomputes the network accumulator from the pieces on the board. Needed when the
+     * network is enabled or changed after the board was set up. Does nothing without nnue=1.
+     */
+    void refresh_accumulator();
     bool board_BB_match();
     /**
      * @brief Does a move. Required: From and to square. Promotion. Changes board state accordingly
@@ -85,11 +137,30 @@ struct Board {
     template <bool is_white, Piece_t type> inline constexpr void remove_piece(const uint8_t square) {
         bb_remove<is_white, type>(square);
         game_board[square] = none_piece;
+        hash ^= zobrist::piece<type, is_white>(square);
+        if constexpr (type == pieces::pawn)
+            pawn_hash ^= zobrist::piece<type, is_white>(square);
+        mg_score -= psqt::mg<type, is_white>(square);
+        eg_score -= psqt::eg<type, is_white>(square);
+        phase -= psqt::phase<type>();
+#ifdef USE_NNUE
+        if (nnue::enabled)
+            acc.remove<type, is_white>(square);
+#endif
     }
     template <bool is_white, Piece_t type> inline constexpr void move_piece(const uint8_t source, const uint8_t target) {
         bb_move<is_white, type>(source, target);
         game_board[target] = game_board[source];
         game_board[source] = none_piece;
+        hash ^= zobrist::piece<type, is_white>(source) ^ zobrist::piece<type, is_white>(target);
+        if constexpr (type == pieces::pawn)
+            pawn_hash ^= zobrist::piece<type, is_white>(source) ^ zobrist::piece<type, is_white>(target);
+        mg_score += psqt::mg<type, is_white>(target) - psqt::mg<type, is_white>(source);
+        eg_score += psqt::eg<type, is_white>(target) - psqt::eg<type, is_white>(source);
+#ifdef USE_NNUE
+        if (nnue::enabled)
+            acc.move<type, is_white>(source, target);
+#endif
     }
 
     template <bool is_white, Piece_t type> constexpr void add_piece(const uint8_t square) {
@@ -99,6 +170,16 @@ struct Board {
             game_board[square] = Piece(pieces::black | type);
         }
         bb_add<is_white, type>(square);
+        hash ^= zobrist::piece<type, is_white>(square);
+        if constexpr (type == pieces::pawn)
+            pawn_hash ^= zobrist::piece<type, is_white>(square);
+        mg_score += psqt::mg<type, is_white>(square);
+        eg_score += psqt::eg<type, is_white>(square);
+        phase += psqt::phase<type>();
+#ifdef USE_NNUE
+        if (nnue::enabled)
+            acc.add<type, is_white>(square);
+#endif
     }
     /**
      * @brief Use this if moveflag not defined yet.
@@ -282,6 +363,9 @@ struct Board {
             full_moves += 1;
 
         uint8_t old_ep = en_passant_square;
+        if (en_passant)
+            hash ^= zobrist::ep(en_passant_square);
+        hash ^= zobrist::castle(castleinfo);  // Castle rights are hashed back in once all flags are updated.
         en_passant = false;
         en_passant_square = 0;
         assert(turn_color == white_to_move ? pieces::white : pieces::black);
@@ -326,6 +410,7 @@ struct Board {
         if constexpr (flag == moveflag::MOVEFLAG_pawn_double_push) {
             en_passant = true;
             en_passant_square = (move.source + move.target) / 2;
+            hash ^= zobrist::ep(en_passant_square);
         }
 
         if constexpr (flag == moveflag::MOVEFLAG_pawn_ep_capture) {
@@ -349,6 +434,7 @@ struct Board {
             remove_piece<white_to_move, pieces::pawn>(move.target);
             add_piece<white_to_move, pieces::rook>(move.target);
         }
+        hash ^= zobrist::castle(castleinfo);
         return info;
     }
 
@@ -404,8 +490,12 @@ struct Board {
     }
     template <bool white_moved> void undo_move(const restore_move_info info, const Move move) {
         ply_moves = info.ply_moves;
+        hash ^= zobrist::castle(castleinfo) ^ zobrist::castle(info.castleinfo);
         castleinfo = info.castleinfo;
+        if (en_passant)
+            hash ^= zobrist::ep(en_passant_square);
         if (info.ep_square != 0) {
+            hash ^= zobrist::ep(info.ep_square);
             en_passant_square = info.ep_square;
             en_passant = true;
         } else {
@@ -455,6 +545,119 @@ struct Board {
         else
             undo_move<true>(info, move);
     }
+    /**
+     * @brief Copies the position, except the mailbox and the accumulator, for restore.
+     */
+    position_snapshot snapshot() const {
+        return {white_rooks,
+                white_pawns,
+                white_knights,
+                white_bishops,
+                white_queen,
+                white_king,
+                white_pieces,
+                black_rooks,
+                black_pawns,
+                black_knights,
+                black_bishops,
+                black_queen,
+                black_king,
+                black_pieces,
+                hash,
+                pawn_hash,
+                full_moves,
+                mg_score,
+                eg_score,
+                phase,
+                castleinfo,
+                turn_color,
+                en_passant_square,
+                check,
+                ply_moves,
+                en_passant};
+    }
+    /**
+     * @brief Takes back a move by copying back the snapshot taken before it (copy-make). Only the
+     * mailbox squares the move touched are rebuilt. The accumulator is not in the snapshot, save it
+     * separately while nnue::enabled.
+     *
+     * @tparam white_moved true if white made the move.
+     * @param[in] s snapshot taken before the move.
+     * @param[in] move the move taken back.
+     */
+    template <bool white_moved> void restore(const position_snapshot &s, const Move move) {
+        constexpr uint8_t us = white_moved ? pieces::white : pieces::black;
+        constexpr uint8_t them = white_moved ? pieces::black : pieces::white;
+        Piece moved = moveflag::is_promotion(move.flag) ? Piece(us | pieces::pawn) : game_board[move.target];
+        white_rooks = s.white_rooks;
+        white_pawns = s.white_pawns;
+        white_knights = s.white_knights;
+        white_bishops = s.white_bishops;
+        white_queen = s.white_queen;
+        white_king = s.white_king;
+        white_pieces = s.white_pieces;
+        black_rooks = s.black_rooks;
+        black_pawns = s.black_pawns;
+        black_knights = s.black_knights;
+        black_bishops = s.black_bishops;
+        black_queen = s.black_queen;
+        black_king = s.black_king;
+        black_pieces = s.black_pieces;
+        hash = s.hash;
+        pawn_hash = s.pawn_hash;
+        full_moves = s.full_moves;
+        mg_score = s.mg_score;
+        eg_score = s.eg_score;
+        phase = s.phase;
+        castleinfo = s.castleinfo;
+        turn_color = s.turn_color;
+        en_passant_square = s.en_passant_square;
+        check = s.check;
+        ply_moves = s.ply_moves;
+        en_passant = s.en_passant;
+
+        game_board[move.source] = moved;
+        game_board[move.target] = piece_from_bitboards<!white_moved>(move.target);
+        if (move.flag == moveflag::MOVEFLAG_pawn_ep_capture) {
+            game_board[white_moved ? move.target - 8 : move.target + 8] = Piece(them | pieces::pawn);
+        } else if (move.flag == moveflag::MOVEFLAG_long_castling) {
+            game_board[white_moved ? 0 : 56] = Piece(us | pieces::rook);
+            game_board[white_moved ? 3 : 59] = none_piece;
+        } else if (move.flag == moveflag::MOVEFLAG_short_castling) {
+            game_board[white_moved ? 7 : 63] = Piece(us | pieces::rook);
+            game_board[white_moved ? 5 : 61] = none_piece;
+        }
+    }
+    /**
+     * @brief Passes the turn without moving, for null move pruning. Clears en passant and updates
+     * the hash. Must not be done while in check.
+     *
+     * @return info to restore the board with undo_null_move.
+     */
+    restore_move_info do_null_move() {
+        restore_move_info info = {ply_moves, en_passant_square, castleinfo, pieces::none};
+        if (en_passant)
+            hash ^= zobrist::ep(en_passant_square);
+        en_passant = false;
+        en_passant_square = 0;
+        ply_moves += 1;
+        change_turn();
+        return info;
+    }
+    /**
+     * @brief Undoes do_null_move.
+     *
+     * @param[in] info info returned by do_null_move.
+     */
+    void undo_null_move(const restore_move_info info) {
+        ply_moves = info.ply_moves;
+        if (info.ep_square != 0) {
+            hash ^= zobrist::ep(info.ep_square);
+            en_passant_square = info.ep_square;
+            en_passant = true;
+        }
+        change_turn();
+    }
 
     /**
      * @brief Calculates if king is in check.
@@ -496,6 +699,35 @@ struct Board {
         checkers |= movegen::pawn_atk_bb<is_white>(king_bb) & get_piece_bb<pieces::pawn, !is_white>();
         return checkers;
     }
+    /**
+     * @brief Gets pieces of both colors attacking a square, given an occupancy. Pieces not in occ
+     * are still included, mask with occ if they should be removed.
+     *
+     * @param[in] sq square attacked
+     * @param[in] occ occupancy blocking sliding pieces
+     * @return BB of attackers
+     */
+    constexpr inline BB attackers_to(uint8_t sq, BB occ) const {
+        BB sq_bb = BitBoard::one_high(sq);
+        BB attackers = movegen::pawn_atk_bb<false>(sq_bb) & white_pawns;
+        attackers |= movegen::pawn_atk_bb<true>(sq_bb) & black_pawns;
+        attackers |= movegen::knight_atk(sq) & (white_knights | black_knights);
+        attackers |= movegen::king_atk(sq) & (white_king | black_king);
+        attackers |= movegen::bishop_atk(sq, occ) & (white_bishops | black_bishops | white_queen | black_queen);
+        attackers |= movegen::rook_atk(sq, occ) & (white_rooks | black_rooks | white_queen | black_queen);
+        return attackers;
+    }
+    /**
+     * @brief Static exchange evaluation. Plays out the captures on the target square of move,
+     * each side always recapturing with its least valuable attacker and able to stop when
+     * recapturing loses material. Sliders behind a capturing piece join in as it leaves. Pins are
+     * ignored.
+     *
+     * @param[in] move move to evaluate, usually a capture.
+     * @param[in] threshold material the move must at least win, in centipawns.
+     * @return true if the exchange wins at least threshold for the side making move.
+     */
+    bool see(Move move, int threshold) const;
 
     /**
      * @brief Get the all the possible legal moves and sets into provided array
@@ -506,89 +738,32 @@ struct Board {
      * @return * size_t: number of legal moves in array.
      */
     template <search_type stype, bool is_white> size_t get_moves(std::array<Move, max_legal_moves> &moves) {
-        BB king_attackers = king_checkers<is_white>();
-        uint8_t count = BitBoard::bitcount(king_attackers);
-        if (count == 0) {
-            return get_moves<stype, no_check, is_white>(moves, king_attackers);
-        } else if (count == 1) {
-            if (king_attackers &
-                (get_piece_bb<pieces::bishop, !is_white>() | get_piece_bb<pieces::rook, !is_white>() | get_piece_bb<pieces::queen, !is_white>())) {
-                return get_moves<stype, slider_check, is_white>(moves, king_attackers);
-            } else {
-                return get_moves<stype, single_check, is_white>(moves, king_attackers);
-            }
-        } else {
-            return get_moves<stype, double_check, is_white>(moves, king_attackers);
-        }
-    }
-    template <search_type stype, check_type ctype, bool is_white> size_t get_moves(std::array<Move, max_legal_moves> &moves, BB king_attackers) {
-        uint8_t kingsq = BitBoard::lsb(get_piece_bb<pieces::king, is_white>());
-        uint8_t color = is_white ? pieces::white : pieces::black;
-        BB friendly_bb = occupancy<is_white>();
-        BB enemy_bb = occupancy<!is_white>();
-        BB to_squares = movegen::king_moves(kingsq, friendly_bb, friendly_bb | enemy_bb, get_atk_bb<!is_white, true>(), castleinfo,
-                                            color);  // Already disqualifies squares that are attacked by the enemy so do not need to check for move legality.
-        size_t num_moves = 0;
-        add_moves<is_white, pieces::king>(moves, num_moves, to_squares, kingsq);
-        // No need to test for move legality.
-        if constexpr (ctype.two_checks) {
-            return num_moves;
-        } else {  // In case of check, valid moves are: Move king, block the checker if a ray piece, or capture the piece.
-            BB occ = friendly_bb | enemy_bb;
-            BB queen_bb = get_piece_bb<pieces::queen, is_white>();
-            BB bishop_bb = get_piece_bb<pieces::bishop, is_white>();
-            BB rook_bb = get_piece_bb<pieces::rook, is_white>();
-            BB pawn_bb = get_piece_bb<pieces::pawn, is_white>();
-            BB knight_bb = get_piece_bb<pieces::knight, is_white>();
-            BB ep_bb = en_passant ? BitBoard::one_high(en_passant_square) : 0;
-
-            // Compute pins
-            BB rook_xraymask = magic::get_rook_xray_atk_bb(kingsq, occ);
-            BB bishop_xraymask = magic::get_bishop_xray_atk_bb(kingsq, occ);
-            BB enemy_rooks = get_piece_bb<pieces::rook, !is_white>() | get_piece_bb<pieces::queen, !is_white>();
-            BB enemy_bishops = get_piece_bb<pieces::bishop, !is_white>() | get_piece_bb<pieces::queen, !is_white>();
-            // If any enemy queens, bishops or rooks are present in these masks, pieces are pinned.
-            BB pinning_rooks = enemy_rooks & rook_xraymask;
-            BB pinrooktemp = pinning_rooks;
-            BB pinning_bishops = enemy_bishops & bishop_xraymask;
-            BB pinbishoptemp = pinning_bishops;
-            // Generate a new mask only between king and enemy pinners, if any,
-            BB rook_pinmask = 0;
-            BB bishop_pinmask = 0;
-            BitLoop(pinrooktemp) {
-                uint8_t pinnerloc = BitBoard::lsb(pinrooktemp);
-                rook_pinmask |= rect_lookup[kingsq][pinnerloc];
-            }
-            BitLoop(pinbishoptemp) {
-                uint8_t pinnerloc = BitBoard::lsb(pinbishoptemp);
-                bishop_pinmask |= rect_lookup[kingsq][pinnerloc];
-            }
-            pininfo pi = {kingsq, rook_pinmask, bishop_pinmask, pinning_rooks, pinning_bishops};
-
-            // Compute checks
-
-            // In the movegenerator, if the piece to be moved is on the rook or bishop pin mask,
-            // then need to obtain the rectangular mask on which it is allowed to move.
-            // This can be done by popping bits in the pinning_rooks BB / pinning_bishops BB, checking if this BB is between this piece and the king.
-            // If it is, the piece is only allowed to move between king and the pinee.
-
-            gen_add_all_moves<pieces::queen, stype, ctype, is_white>(moves, num_moves, queen_bb, friendly_bb, enemy_bb, pi, ep_bb, king_attackers);
-            gen_add_all_moves<pieces::bishop, stype, ctype, is_white>(moves, num_moves, bishop_bb, friendly_bb, enemy_bb, pi, ep_bb, king_attackers);
-            gen_add_all_moves<pieces::rook, stype, ctype, is_white>(moves, num_moves, rook_bb, friendly_bb, enemy_bb, pi, ep_bb, king_attackers);
-            gen_add_all_moves<pieces::knight, stype, ctype, is_white>(moves, num_moves, knight_bb, friendly_bb, enemy_bb, pi, ep_bb, king_attackers);
-            gen_add_all_moves<pieces::pawn, stype, ctype, is_white>(moves, num_moves, pawn_bb, friendly_bb, enemy_bb, pi, ep_bb, king_attackers);
-            return num_moves;
-        }
+        return gen_moves<stype, is_white, false>(moves.data());
     }
+    /**
+     * @brief Same as above, but writes to a pointer. Used when generating moves in stages into
+     * the same array.
+     *
+     * @param moves pointer to room for at least max_legal_moves moves.
+     */
+    template <search_type stype, bool is_white> size_t get_moves(Move *moves) { return gen_moves<stype, is_white, false>(moves); }
+    /**
+     * @brief Counts the legal moves without generating them. Sums popcounts of the legal target
+     * squares of each piece, promotions count four times. Used at the leaves of perft.
+     *
+     * @tparam is_white if is white or not.
+     * @return number of legal moves.
+     */
+    template <bool is_white> size_t count_moves() { return gen_moves<normal_search, is_white, true>(nullptr); }
     /**
      * @brief Changes whose turn it is: white <-> black. Only the turn_color parameter
      * is changed.
      *
      */
     void change_turn() {
-        turn_color ^= pieces::color_mask;
-    }  // Xor with color mask to change
-       // color.
+        turn_color ^= pieces::color_mask;  // Xor with color mask to change color.
+        hash ^= zobrist::black();
+    }
 
     void reset() {
         castleinfo = err_val8;
@@ -624,9 +799,9 @@ struct Board {
 
     inline Piece get_piece_at(uint8_t square) const { return game_board[square]; }
 
-    bool is_square_empty(uint8_t square) const;
+    inline bool is_square_empty(uint8_t square) const { return game_board[square] == none_piece; }
 
-    uint8_t get_square_color(uint8_t square) const;
+    inline uint8_t get_square_color(uint8_t square) const { return game_board[square].get_color(); }
 
     void clear_board();
 
@@ -734,6 +909,14 @@ struct Board {
      * @return Number of pieces
      */
     template <Piece_t piece, bool is_white> constexpr inline uint8_t get_piece_cnt() const { return BitBoard::bitcount(get_piece_bb<piece, is_white>()); }
+    /**
+     * @brief True if the side has any piece besides pawns and king. Without one, zugzwang is
+     * common and passing the turn is not a safe lower bound.
+     */
+    template <bool is_white> constexpr inline bool has_non_pawn_material() const {
+        return (get_piece_bb<pieces::knight, is_white>() | get_piece_bb<pieces::bishop, is_white>() | get_piece_bb<pieces::rook, is_white>() |
+                get_piece_bb<pieces::queen, is_white>()) != 0;
+    }
 
     constexpr inline BB occupancy() const { return occupancy<true>() | occupancy<false>(); }
     template <bool is_white> constexpr inline BB occupancy() const {
@@ -776,6 +959,145 @@ struct Board {
     }
 
  protected:
+    /**
+     * @brief Selects check type and generates (or counts) moves.
+     *
+     * @tparam count_only if true, moves are only counted and moves may be nullptr.
+     * @param[out] moves array of at least max_legal_moves moves.
+     * @return number of legal moves.
+     */
+    template <search_type stype, bool is_white, bool count_only> size_t gen_moves(Move *moves) {
+        BB king_attackers = king_checkers<is_white>();
+        uint8_t count = BitBoard::bitcount(king_attackers);
+        if (count == 0) {
+            return gen_moves<stype, no_check, is_white, count_only>(moves, king_attackers);
+        } else if (count == 1) {
+            if (king_attackers &
+                (get_piece_bb<pieces::bishop, !is_white>() | get_piece_bb<pieces::rook, !is_white>() | get_piece_bb<pieces::queen, !is_white>())) {
+                return gen_moves<stype, slider_check, is_white, count_only>(moves, king_attackers);
+            } else {
+                return gen_moves<stype, single_check, is_white, count_only>(moves, king_attackers);
+            }
+        } else {
+            return gen_moves<stype, double_check, is_white, count_only>(moves, king_attackers);
+        }
+    }
+    template <search_type stype, check_type ctype, bool is_white, bool count_only> size_t gen_moves(Move *moves, BB king_attackers) {
+        uint8_t kingsq = BitBoard::lsb(get_piece_bb<pieces::king, is_white>());
+        uint8_t color = is_white ? pieces::white : pieces::black;
+        BB friendly_bb = occupancy<is_white>();
+        BB enemy_bb = occupancy<!is_white>();
+        BB to_squares = movegen::king_moves(kingsq, friendly_bb, friendly_bb | enemy_bb, get_atk_bb<!is_white, true>(), castleinfo,
+                                            color);  // Already disqualifies squares that are attacked by the enemy so do not need to check for move legality.
+        to_squares &= stype_mask<pieces::king, stype, is_white>(enemy_bb, 0);
+        checkinfo ci = {};
+        if constexpr (stype.quiet_check_search) {
+            ci = get_checkinfo<is_white>();
+            to_squares &= check_targets<pieces::king>(ci, kingsq);
+        }
+        size_t num_moves = 0;
+        add_moves<is_white, pieces::king, count_only>(moves, num_moves, to_squares, kingsq);
+        // No need to test for move legality.
+        if constexpr (ctype.two_checks) {
+            return num_moves;
+        } else {  // In case of check, valid moves are: Move king, block the checker if a ray piece, or capture the piece.
+            BB occ = friendly_bb | enemy_bb;
+            BB queen_bb = get_piece_bb<pieces::queen, is_white>();
+            BB bishop_bb = get_piece_bb<pieces::bishop, is_white>();
+            BB rook_bb = get_piece_bb<pieces::rook, is_white>();
+            BB pawn_bb = get_piece_bb<pieces::pawn, is_white>();
+            BB knight_bb = get_piece_bb<pieces::knight, is_white>();
+            BB ep_bb = en_passant ? BitBoard::one_high(en_passant_square) : 0;
+
+            // Compute pins
+            BB rook_xraymask = magic::get_rook_xray_atk_bb(kingsq, occ);
+            BB bishop_xraymask = magic::get_bishop_xray_atk_bb(kingsq, occ);
+            BB enemy_rooks = get_piece_bb<pieces::rook, !is_white>() | get_piece_bb<pieces::queen, !is_white>();
+            BB enemy_bishops = get_piece_bb<pieces::bishop, !is_white>() | get_piece_bb<pieces::queen, !is_white>();
+            // If any enemy queens, bishops or rooks are present in these masks, pieces are pinned.
+            BB pinning_rooks = enemy_rooks & rook_xraymask;
+            BB pinrooktemp = pinning_rooks;
+            BB pinning_bishops = enemy_bishops & bishop_xraymask;
+            BB pinbishoptemp = pinning_bishops;
+            // Generate a new mask only between king and enemy pinners, if any,
+            BB rook_pinmask = 0;
+            BB bishop_pinmask = 0;
+            BitLoop(pinrooktemp) {
+                uint8_t pinnerloc = BitBoard::lsb(pinrooktemp);
+                rook_pinmask |= rect_lookup[kingsq][pinnerloc];
+            }
+            BitLoop(pinbishoptemp) {
+                uint8_t pinnerloc = BitBoard::lsb(pinbishoptemp);
+                bishop_pinmask |= rect_lookup[kingsq][pinnerloc];
+            }
+            pininfo pi = {kingsq, rook_pinmask, bishop_pinmask, pinning_rooks, pinning_bishops};
+
+            // Compute checks
+
+            // In the movegenerator, if the piece to be moved is on the rook or bishop pin mask,
+            // then need to obtain the rectangular mask on which it is allowed to move.
+            // This can be done by popping bits in the pinning_rooks BB / pinning_bishops BB, checking if this BB is between this piece and the king.
+            // If it is, the piece is only allowed to move between king and the pinee.
+
+            gen_add_all_moves<pieces::queen, stype, ctype, is_white, count_only>(moves, num_moves, queen_bb, friendly_bb, enemy_bb, pi, ci, ep_bb, king_attackers);
+            gen_add_all_moves<pieces::bishop, stype, ctype, is_white, count_only>(moves, num_moves, bishop_bb, friendly_bb, enemy_bb, pi, ci, ep_bb, king_attackers);
+            gen_add_all_moves<pieces::rook, stype, ctype, is_white, count_only>(moves, num_moves, rook_bb, friendly_bb, enemy_bb, pi, ci, ep_bb, king_attackers);
+            gen_add_all_moves<pieces::knight, stype, ctype, is_white, count_only>(moves, num_moves, knight_bb, friendly_bb, enemy_bb, pi, ci, ep_bb, king_attackers);
+            gen_add_all_moves<pieces::pawn, stype, ctype, is_white, count_only>(moves, num_moves, pawn_bb, friendly_bb, enemy_bb, pi, ci, ep_bb, king_attackers);
+            return num_moves;
+        }
+    }
+    /**
+     * @brief Gets what quiet_check_search needs to find checking moves: the squares from which each
+     * piece type attacks the enemy king, and the own pieces that uncover a check from a slider
+     * behind them when they leave its line.
+     */
+    template <bool is_white> checkinfo get_checkinfo() const {
+        checkinfo ci = {};
+        BB enemy_king_bb = get_piece_bb<pieces::king, !is_white>();
+        uint8_t ksq = BitBoard::lsb(enemy_king_bb);
+        BB occ = occupancy();
+        ci.enemy_kingloc = ksq;
+        ci.direct_checks[pieces::pawn] = movegen::pawn_atk_bb<!is_white>(enemy_king_bb);
+        ci.direct_checks[pieces::knight] = movegen::knight_atk(ksq);
+        ci.direct_checks[pieces::bishop] = movegen::bishop_atk(ksq, occ);
+        ci.direct_checks[pieces::rook] = movegen::rook_atk(ksq, occ);
+        ci.direct_checks[pieces::queen] = ci.direct_checks[pieces::bishop] | ci.direct_checks[pieces::rook];
+
+        // Own sliders seen from the enemy king through one blocker. If the blocker is ours, it can discover check.
+        BB queen_bb = get_piece_bb<pieces::queen, is_white>();
+        BB sliders = (magic::get_rook_xray_atk_bb(ksq, occ) & (get_piece_bb<pieces::rook, is_white>() | queen_bb)) |
+                     (magic::get_bishop_xray_atk_bb(ksq, occ) & (get_piece_bb<pieces::bishop, is_white>() | queen_bb));
+        BB friendly_bb = occupancy<is_white>();
+        BitLoop(sliders) {
+            BB slider_bb = BitBoard::lsb_bb(sliders);
+            BB blocker = rect_lookup[ksq][BitBoard::lsb(sliders)] & friendly_bb & ~slider_bb;
+            if (blocker) {
+                ci.discoverers |= blocker;
+                ci.discovery_sliders |= slider_bb;
+            }
+        }
+        return ci;
+    }
+    /**
+     * @brief Squares a piece on sq gives check from, directly or by leaving the line of a
+     * discovering slider.
+     */
+    template <Piece_t ptype> static BB check_targets(const checkinfo &ci, uint8_t sq) {
+        BB targets = ci.direct_checks[ptype];
+        BB sqbb = BitBoard::one_high(sq);
+        if (ci.discoverers & sqbb) {
+            BB sliders = ci.discovery_sliders;
+            BitLoop(sliders) {
+                BB line = rect_lookup[ci.enemy_kingloc][BitBoard::lsb(sliders)];
+                if (line & sqbb) {
+                    targets |= ~line;
+                    break;
+                }
+            }
+        }
+        return targets;
+    }
     template <bool is_white> int get_pawn_promote_rank() const {
         if constexpr (is_white)
             return 7;
@@ -791,8 +1113,23 @@ struct Board {
      * @param[in] to_bb bitboard containing attacking squares. will be destroyed by
      * calling this routine
      * @param[in] from from square.
+     * @tparam count_only only increase num_moves, moves is not written.
      */
-    template <bool is_white, Piece_t type> void add_moves(std::array<Move, max_legal_moves> &moves, size_t &num_moves, uint64_t &to_bb, const uint8_t from) {
+    template <bool is_white, Piece_t type, bool count_only = false> void add_moves(Move *moves, size_t &num_moves, uint64_t &to_bb, const uint8_t from) {
+        if constexpr (count_only) {
+            if constexpr (type == pieces::pawn) {
+                num_moves += 3 * BitBoard::bitcount(to_bb & masks::row(get_pawn_promote_rank<is_white>()));  // 4 moves per promotion.
+                if (en_passant && (to_bb & BitBoard::one_high(en_passant_square))) {
+                    Move testmove = Move(from, en_passant_square, moveflag::MOVEFLAG_pawn_ep_capture);
+                    auto info = do_move<is_white, pieces::pawn, moveflag::MOVEFLAG_pawn_ep_capture, pieces::none>(testmove);
+                    bool iskingcheck = king_checked<is_white>();
+                    undo_move<is_white>(info, testmove);
+                    num_moves -= iskingcheck;
+                }
+            }
+            num_moves += BitBoard::bitcount(to_bb);
+            return;
+        }
         constexpr uint8_t friendly_longsq = is_white ? 0 : 56;
         constexpr uint8_t friendly_shortsq = is_white ? 7 : 63;
         BitLoop(to_bb) {
@@ -854,13 +1191,14 @@ struct Board {
      * method
      * @param[in] friendly_bb bb with all friendly pieces
      * @param[in] enemy_bb bb with all enemy pieces
+     * @param[in] ci check info, only used by quiet_check_search
      * @param[in] ep_bb bitboard with en passant square
      * @param[in] castleinfo int containing info about a castle
      * @param[in] turn_color color of player
      */
-    template <Piece_t ptype, search_type stype, check_type ctype, bool is_white>
-    void gen_add_all_moves(std::array<Move, max_legal_moves> &moves, size_t &num_moves, uint64_t &piece_bb, const uint64_t friendly_bb, const uint64_t enemy_bb,
-                           const pininfo pi, const uint64_t ep_bb, const BB king_attacker) {
+    template <Piece_t ptype, search_type stype, check_type ctype, bool is_white, bool count_only>
+    void gen_add_all_moves(Move *moves, size_t &num_moves, uint64_t &piece_bb, const uint64_t friendly_bb, const uint64_t enemy_bb,
+                           const pininfo pi, const checkinfo &ci, const uint64_t ep_bb, const BB king_attacker) {
         BB checker_mask = ~0;
         if constexpr (ctype.slider_check) {
             checker_mask = rect_lookup[pi.kingloc][BitBoard::lsb(king_attacker)];  // Allowed to go in between, or to capture
@@ -906,11 +1244,13 @@ struct Board {
             uint8_t sq = BitBoard::lsb(piece_bb);
             uint64_t to_sqs = to_squares<ptype, stype, is_white>(sq, friendly_bb, enemy_bb, ep_bb, castleinfo);
             to_sqs &= pin_mask;
+            if constexpr (stype.quiet_check_search)
+                to_sqs &= check_targets<ptype>(ci, sq);
 
             if constexpr (ctype.one_check || ctype.slider_check) {
                 to_sqs &= checker_mask;
             }
-            add_moves<is_white, ptype>(moves, num_moves, to_sqs, sq);
+            add_moves<is_white, ptype, count_only>(moves, num_moves, to_sqs, sq);
         }
     }
 
@@ -945,11 +1285,49 @@ struct Board {
         } else if constexpr (ptype == pieces::king) {
             to_squares = movegen::king_moves(sq, friendly_bb, friendly_bb | enemy_bb, get_atk_bb<!is_white, true>(), castleinfo, color);
         }
-        if constexpr (s_type.quiesence_search) {  // Only search for captures
-                                                  // in Quiesence.
-            to_squares &= enemy_bb;
-        }
-        return to_squares;
+        return to_squares & stype_mask<ptype, s_type, is_white>(enemy_bb, ep_bb);
+    }
+    /**
+     * @brief Mask of target squares a search type generates moves to.
+     *
+     * @tparam[in] ptype Piece type
+     * @tparam[in] s_type type of search.
+     * @param[in] enemy_bb Bit board of all enemy pieces
+     * @param[in] ep_bb En passant bit board
+     * @return bitboard of allowed target squares.
+     */
+    template <Piece_t ptype, search_type s_type, bool is_white> static constexpr BB stype_mask(BB enemy_bb, BB ep_bb) {
+        BB tactical = enemy_bb;
+        if constexpr (ptype == pieces::pawn)
+            tactical |= ep_bb | masks::row(is_white ? 7 : 0);
+        if constexpr (s_type.quiesence_search)  // Only search for captures in Quiesence.
+            return enemy_bb;
+        else if constexpr (s_type.tactical_search)
+            return tactical;
+        else if constexpr (s_type.quiet_search || s_type.quiet_check_search)
+            return ~tactical;
+        else
+            return masks::fill;
+    }
+    /**
+     * @brief Piece of one color on a square, read from the bitboards.
+     *
+     * @return the piece, or none_piece if no piece of that color is there.
+     */
+    template <bool is_white> inline Piece piece_from_bitboards(const uint8_t sq) const {
+        constexpr uint8_t color = is_white ? pieces::white : pieces::black;
+        BB bb = BitBoard::one_high(sq);
+        if ((get_piece_bb<pieces::pawn, is_white>() & bb) != 0)
+            return Piece(color | pieces::pawn);
+        if ((get_piece_bb<pieces::knight, is_white>() & bb) != 0)
+            return Piece(color | pieces::knight);
+        if ((get_piece_bb<pieces::bishop, is_white>() & bb) != 0)
+            return Piece(color | pieces::bishop);
+        if ((get_piece_bb<pieces::rook, is_white>() & bb) != 0)
+            return Piece(color | pieces::rook);
+        if ((get_piece_bb<pieces::queen, is_white>() & bb) != 0)
+            return Piece(color | pieces::queen);
+        return none_piece;  // Kings are never captured.
     }
     /**
      * @brief Handles moving piece on bitboard.
@@ -2,13 +2,37 @@
 #ifndef CONFIG_H
 #define CONFIG_H
 
+#include <array>
 #include <string>
 inline std::string const ID_name = "chiral_ebt";
 inline std::string const ID_author = "filipa";
 inline std::string const ID_version = "0.3";
+inline std::string const DEFAULT_EVAL_FILE = "nnue.bin";  // Network loaded at startup if it exists, see nnue.h.
 
-constexpr int STANDARD_TIME = 60 * 1000;  // 60 seconds. 60 * 5 * 1000;  // 5 minutes
-constexpr int STANDARD_TINC = 0;          // 0 seconds additional per move.
-constexpr int STANDARD_TIME_BUFFER = 10;  // 50 ms buffer to aim for.
-constexpr int STANDARD_TIME_FRAC = 25;    // use 1/40th of remanining itme
+constexpr int STANDARD_TIME = 60 * 1000;     // 60 seconds. 60 * 5 * 1000;  // 5 minutes
+constexpr int STANDARD_TINC = 0;             // 0 seconds additional per move.
+constexpr int STANDARD_TIME_BUFFER = 10;     // 50 ms buffer to aim for.
+constexpr int STANDARD_TIME_FRAC = 25;       // use 1/40th of remanining itme
+constexpr int MAX_THREADS = 256;             // Upper limit of the UCI option Threads.
+constexpr int DEFAULT_HASH_MB = 16;          // Default size of transposition table (UCI option Hash).
+constexpr int MAX_HASH_MB = 65536;           // Upper limit of the UCI option Hash.
+constexpr int INFO_QUEUE_SIZE = 64;          // Info messages the search can queue before the printing thread takes them. Power of two.
+constexpr int INFO_POLL_MS = 1;              // Interval of the printing thread checking the info queue during a search.
+constexpr int INFO_FINAL_WAIT_MS = 50;       // Longest the search waits for room in the info queue for its last iteration's info.
+constexpr int ASPIRATION_WINDOW = 25;        // Half width in cp of the first aspiration window. Doubled on each fail.
+constexpr int ASPIRATION_MAX_WINDOW = 800;   // Beyond this the failing side of the window is opened fully.
+constexpr int ASPIRATION_MIN_DEPTH = 4;      // Shallower iterations are cheap, search them with a full window.
+constexpr int NULL_MOVE_MIN_DEPTH = 3;       // Null move pruning is only tried with at least this remaining depth.
+constexpr int NULL_MOVE_VERIFY_DEPTH = 10;   // From this depth a null move cutoff is verified by a reduced normal search.
+constexpr int LMR_MIN_DEPTH = 3;             // Late move reductions are only applied with at least this remaining depth.
+constexpr int LMR_MIN_MOVES = 3;             // Number of moves searched at full depth before reducing.
+constexpr int LMR_HISTORY_DIVISOR = 4096;    // History score worth one ply less reduction.
+constexpr int DELTA_MARGIN = 200;            // Margin in cp on top of the captured piece for delta pruning in quiesence.
+constexpr int QSEARCH_CHECK_PLIES = 1;       // Quiesence plies that also search quiet checking moves. 0 for captures only.
+constexpr int PAWN_HASH_ENTRIES = 1 << 13;   // Pawn structure cache entries per search thread. Power of two.
+constexpr int EVAL_CACHE_ENTRIES = 1 << 14;  // Static eval cache entries per search thread. Power of two.
+constexpr int MAX_PLY = 64;                  // Deepest ply the search reaches, quiesence included. Iterations go to MAX_PLY - 1.
+// Margins in cp by remaining depth. Pruning is only done at depths covered by the table.
+constexpr std::array<int, 4> REVERSE_FUTILITY_MARGINS = {0, 100, 200, 300};
+constexpr std::array<int, 4> FUTILITY_MARGINS = {0, 150, 250, 350};
 #endif
@@ -4,42 +4,87 @@
 #include <algorithm>
 #include <array>
 #include <board.h>
-namespace helpers {
+#include <config.h>
+#include <optional>
+#include <vector>
+
+/**
+ * @brief Pawn structure of a position, computed only from the pawns. Kept for the king safety and
+ * endgame terms too, not only the score.
+ */
+struct pawn_entry {
+    uint64_t key = ~0ULL;                         // pawn hash. Empty slots hold a key no pawn structure hashes to in practice.
+    int score = 0;                                // passed, doubled and solo pawn score, white positive.
+    std::array<BB, 2> passed = {};                // passed pawns, indexed by is_white.
+    std::array<uint8_t, 2> semi_open_files = {};  // one bit per file without own pawns, indexed by is_white.
+};
+/**
+ * @brief Direct mapped cache of pawn structures keyed on Board::get_pawn_hash. The pawns rarely
+ * change between nearby nodes, so almost all lookups hit. One per search thread, not shared.
+ */
+class pawn_table {
+ public:
+    pawn_table() : arr(PAWN_HASH_ENTRIES) {}
+    /**
+     * @brief Slot of a pawn hash. Holds another structure if its key differs.
+     */
+    pawn_entry &slot(uint64_t pawn_hash) { return arr[pawn_hash & (arr.size() - 1)]; }
+    uint64_t probes = 0;
+    uint64_t hits = 0;
+
+ private:
+    std::vector<pawn_entry> arr;
+    static_assert((PAWN_HASH_ENTRIES & (PAWN_HASH_ENTRIES - 1)) == 0, "PAWN_HASH_ENTRIES must be a power of two");
+};
+struct eval_entry {
+    uint64_t key = ~0ULL;  // zobrist hash of the position, side to move included.
+    int score = 0;         // static eval relative to the side to move.
+};
 /**
- * @brief Get manhattan distance between two squares
- *
- * @param[in] sq1 square1
- * @param[in] sq2 square2
- * @return manhattan distance between squares
+ * @brief Direct mapped cache of static evals keyed on Board::get_hash. Transpositions and the
+ * repeated searches of iterative deepening, aspiration and null windows evaluate the same positions
+ * again. One per search thread, not shared. Only valid for one eval configuration, clear it when
+ * that changes.
  */
-constexpr uint8_t manhattan(uint8_t sq1, uint8_t sq2) {
-    uint8_t r1, c1, r2, c2;
-    r1 = NotationInterface::row(sq1);
-    r2 = NotationInterface::row(sq2);
-    c1 = NotationInterface::col(sq1);
-    c2 = NotationInterface::col(sq2);
-    int rdist = static_cast<int>(r1) - static_cast<int>(r2);
-    rdist = rdist < 0 ? -rdist : rdist;
-    int cdist = static_cast<int>(c1) - static_cast<int>(c2);
-    cdist = cdist < 0 ? -cdist : cdist;
-    return rdist + cdist;
-}
-constexpr std::array<uint8_t, 64> dist2centre = [] {
-    constexpr std::array<uint8_t, 4> centre_squares = {27, 28, 35, 36};
-    std::array<uint8_t, 64> distances;
-    for (int i = 0; i < 64; i++) {
-        uint8_t dist = 64;
-        for (uint8_t c : centre_squares) {
-            dist = std::min(manhattan(c, i), dist);
-        }
-        distances[i] = dist;
-    }
-    return distances;
-}();
-}  // namespace helpers
+class eval_cache {
+ public:
+    eval_cache() : arr(EVAL_CACHE_ENTRIES) {}
+    /**
+     * @brief Slot of a hash. Holds another position if its key differs.
+     */
+    eval_entry &slot(uint64_t hash) { return arr[hash & (arr.size() - 1)]; }
+    void clear() { std::fill(arr.begin(), arr.end(), eval_entry()); }
+    uint64_t probes = 0;
+    uint64_t hits = 0;
+
+ private:
+    std::vector<eval_entry> arr;
+    static_assert((EVAL_CACHE_ENTRIES & (EVAL_CACHE_ENTRIES - 1)) == 0, "EVAL_CACHE_ENTRIES must be a power of two");
+};
+
 class EvalState {
  public:
-    static int eval(Board &board);
+    /**
+     * @brief Static evaluation relative to the side to move.
+     *
+     * @param[in] board board state
+     * @param[inout] pawns cache of pawn structures. If null, the pawn structure is computed.
+     * @return score, positive if the side to move is better.
+     */
+    static int eval(Board &board, pawn_table *pawns = nullptr);
+    /**
+     * @brief Same as eval, looked up in an eval cache first and stored there on a miss.
+     *
+     * @param[in] board board state
+     * @param[inout] evals cache of static evals.
+     * @param[inout] pawns cache of pawn structures. May be null.
+     * @return score, positive if the side to move is better.
+     */
+    static int cached_eval(Board &board, eval_cache &evals, pawn_table *pawns = nullptr);
+    /**
+     * @brief Computes the pawn structure of a board, uncached.
+     */
+    static pawn_entry eval_pawns(const Board &board);
 
     static constexpr int MATE_SCORE = 30000;
     static std::optional<int> moves_to_mate(int score);
@@ -53,60 +98,24 @@ class EvalState {
     static bool forced_draw_ply(Board &board);
 
  private:
-    static int eval_material(Board &board);
-    template <Piece_t p> static int eval_single_piece(Board &board);
-
-    static int eval_mobility(Board &board);
-    /**
-     * @brief Evaluates king distance to centre score. At early game its negative, encouraging
-     * safe play. Late game its positive, encouraging using the king.
-     *
-     * @param[in] state board state
-     * @return evaluation of king distance to centre
-     */
-    static int eval_king_dist2centre(Board &board);
     /**
-     * @brief Gets game phase in [0, 1] by linear interpolation of the number of pieces
+     * @brief Tapered blend of the board's midgame and endgame material and piece-square sums,
+     * weighted by the game phase.
      *
-     * @param[in] num_pieces Number of pieces and pawns
-     * @return Game phase. 0 is early game and 1 is end game
+     * @param[in] board board state
+     * @return score, normalised by white winning is positive.
      */
-    constexpr static float eval_game_phase(const int num_pieces) { return 1. - (num_pieces - 1.) / 15.; }
+    static int eval_psqt(Board &board);
+    static int eval_bishop_pair(Board &board);
 
     /**
      * @brief Score for pawn structure. Passed pawns, unprotected pawns, blocking pawns, etc.
      *
      * @param[in] board board to check.
+     * @param[inout] pawns cache of pawn structures. May be null.
      * @return score for pawn structure, normalised by white winning is positive.
      */
-    static int eval_pawn_structure(Board &board);
+    static int eval_pawn_structure(Board &board, pawn_table *pawns);
 };
 
-namespace PieceValue {
-static constexpr int king = 200000;
-static constexpr int pawn = 100;
-static constexpr int knight = 290;
-static constexpr int bishop = 300;
-static constexpr int rook = 500;
-static constexpr int queen = 900;
-static constexpr int bishop_double_bonus = 25;
-static constexpr std::array<int, 7> piecevals = {0, king, queen, rook, knight, bishop, pawn};
-
-static constexpr int inv_frac = 10;  // Fraction of extra value piece is worth extra from having more spaces to move to.
-// Formula is : piece_val * num_moves / max_possible_moves * frac
-static constexpr int pawn_moveval = 0;
-static constexpr int knight_moveval = knight / (8 * inv_frac);
-static constexpr int bishop_moveval = bishop / (14 * inv_frac);
-static constexpr int rook_moveval = rook / (14 * inv_frac);
-static constexpr int queen_moveval = 0;
-static constexpr int king_moveval = -6;
-static constexpr std::array<int, 7> movevals = {0, king_moveval, queen_moveval, rook_moveval, knight_moveval, bishop_moveval, pawn_moveval};
-
-static constexpr int king_dist2centre_value = 5;
-//
-static constexpr int passed_pawn_eval = 30;
-static constexpr int doubled_pawn_punishment = -15;
-static constexpr int solo_pawn_punishment = -15;
-};  // namespace PieceValue
-
 #endif
@@ -1,16 +1,20 @@
 // Copyright 2025 Filip Agert
 #include <board.h>
 #include <constants.h>
+#include <eval.h>
 #include <memory>
 #include <move.h>
+#include <moveorder.h>
 #include <notation_interface.h>
 #include <piece.h>
 #include <tables.h>
 #include <time_manager.h>
 
-#include <queue>
-#include <stack>
+#include <atomic>
+#include <mutex>
+#include <spsc_queue.h>
 #include <string>
+#include <thread>
 #include <vector>
 
 struct InfoMsg {
@@ -24,9 +28,36 @@ struct InfoMsg {
     int score = 0;              // Current evaluated best move score
     int d0score = 0;            // Score of state (no going deep)
     int hashfill = 0;
+    bool lowerbound = false;               // score is a lower bound: the search failed high on the aspiration window.
+    bool upperbound = false;               // score is an upper bound: the search failed low on the aspiration window.
+    double ebf = 0;                        // Effective branching factor: nodes of this iteration over nodes of the previous one.
+    uint64_t reverse_futility_prunes = 0;  // Nodes cut by reverse futility pruning, main thread.
+    uint64_t futility_prunes = 0;          // Quiet moves skipped by futility pruning, main thread.
+    uint64_t delta_prunes = 0;             // Captures skipped by delta pruning in quiesence, main thread.
+    double pawn_hash_hits = 0;             // Fraction of pawn structure lookups found in the pawn hash table, main thread.
+    double eval_cache_hits = 0;            // Fraction of static evals found in the eval cache, main thread.
+    uint64_t allocations = 0;              // Heap allocations made inside the search, main thread. Expected to be 0.
     bool stringmsg = false;
     std::string string;
 };
+/**
+ * @brief Data of one ply of the search, indexed by ply. Entry 0 is the root. Kept in a fixed array
+ * so a search does not allocate.
+ */
+struct search_stack_entry {
+    Move move;                  // Move made from this ply.
+    restore_move_info restore;  // Takes back move, or the null move.
+#ifdef COPY_MAKE
+    position_snapshot snapshot;  // Position before move, takes it back in copy-make.
+#ifdef USE_NNUE
+    nnue::accumulator acc;  // Only saved while nnue::enabled.
+#endif
+#endif
+    uint64_t hash = 0;            // Hash of the position at this ply.
+    int static_eval = 0;          // Static eval of the position, 0 where the search did not need it.
+    std::array<Move, 2> killers;  // The two latest quiet moves causing a beta cutoff at this ply.
+    bool in_check = false;
+};
 class Game {
  public:
     static Game &instance() {
@@ -37,19 +68,40 @@ class Game {
     void end_game();
 
     /**
-     * @brief Returns true if this board state has occured already in the tree. This means that if
-     * the zobroist hash is already in the game stack. It is okay with just one and not thrice,
-     * since its easier and since the state is deterministic anyway.
+     * @brief Returns true if this board state has occured three times: on the search path to
+     * this ply and in the game before the root.
      *
+     * @param[in] ply ply of the position in the search. 0 for the root.
      * @return true if this position already occured.
      */
-    bool check_repetition();
+    bool check_repetition(int ply);
     /**
      * @brief Enter the game loop logic. This should be called when UCI command GO is received.
-     * @param rem_time: Time control structure from input.
+     * Returns when a limit is reached or stop is called from another thread.
+     * @param limits: Limits of the search from input.
      *
      */
-    void start_thinking(const time_control rem_time);
+    void start_thinking(const search_limits &limits);
+    /**
+     * @brief Searches on a clock, to at most depth_limit.
+     */
+    void start_thinking(const time_control rem_time, int depth_limit = max_depth) {
+        start_thinking(search_limits{.clock = rem_time, .depth = depth_limit});
+    }
+    /**
+     * @brief Stops the current search, or the next one if it has not set up its time manager yet.
+     * Called from the input thread while start_thinking runs on another.
+     */
+    void stop();
+    /**
+     * @brief Starts counting time in the current search, which was started pondering.
+     */
+    void ponderhit();
+    /**
+     * @brief Forgets stop and ponderhit calls. Called before a search is started, not by it, so
+     * that a stop arriving before the search sets up is not lost.
+     */
+    void reset_signals();
 
     /**
      * @brief Alpha beta pruning. This is quite complicated. alpha is the maximal guaranteed score
@@ -64,39 +116,60 @@ class Game {
      * @param[[TODO:direction]] alpha Maximum guaranteed score of maximising player.
      * @param[[TODO:direction]] beta Minimum guaranteeds core of minimising player
      * @param[in] num_extensions - number of move extensions performed so far
+     * @param[in] allow_null - false to not try a null move at this node, e.g. right after one.
      * @return Score of current state.
      */
-    template <bool is_root, bool is_white> int alpha_beta(int depth, int ply, int alpha, int beta, int num_extensions);
+    template <bool is_root, bool is_white> int alpha_beta(int depth, int ply, int alpha, int beta, int num_extensions, bool allow_null = true);
     /**
-     * @brief Quiesence search. Only evaluates captures
+     * @brief Quiesence search. Evaluates captures, and quiet checks in the first QSEARCH_CHECK_PLIES
+     * plies. When in check all evasions are searched instead and there is no stand pat.
      * @param [in] ply - Number of ply moves deep. 0 is root node and counting up.
      * @param[in] alpha Maximum guaranteed score of maximising player.
      * @param[in] beta Minimum guaranteeds core of minimising player
+     * @param[in] qply Number of ply moves into the quiesence search.
      * @return Score of current state.
      */
-    template <bool is_white> int quiesence(int ply, int alpha, int beta);
+    template <bool is_white> int quiesence(int ply, int alpha, int beta, int qply = 0);
 
     /**
-     * @brief Computes the extension for this move
+     * @brief Computes the extension for the move just played: one ply if it gives check.
      *
-     * @param[in] move move played
-     * @param[in] board board state
+     * @param[in] gives_check true if the move gives check
      * @param[in] num_extensions number of extensions previously performed
      * @return move extensions
      */
-    template <bool is_white> int calculate_extension(const Move move, uint8_t movenum, int num_extensions) const;
+    int calculate_extension(bool gives_check, int num_extensions) const;
+
+    /**
+     * @brief Records a quiet move that caused a beta cutoff: makes it the first killer of this ply
+     * and raises its history, lowering the history of the quiet moves searched before it.
+     *
+     * @param[in] move quiet move causing the cutoff
+     * @param[in] ply ply of node
+     * @param[in] depth remaining depth of node
+     * @param[in] quiets quiet moves searched before move
+     * @param[in] num_quiets number of moves in quiets
+     */
+    template <bool is_white> void update_quiet_stats(Move move, int ply, int depth, const std::array<Move, max_legal_moves> &quiets, int num_quiets);
 
     /**
      * @brief Gets the current best known move to send to GUI.
      *
      */
     Move get_bestmove() const;
+    /**
+     * @brief Gets number of nodes searched by all threads in the latest search.
+     *
+     */
+    uint64_t get_total_nodes() const;
+    /**
+     * @brief Plays a move of the game, e.g. from the UCI position command. Moves of the game are
+     * never taken back, only their hashes are kept for repetitions.
+     */
     template <bool is_white> void make_move_no_flag(Move move) {
-        restore_move_info info = board.do_move_no_flag<is_white>(move);
-        move_stack.push(move);
-        restore_info_stack.push(info);
-        uint64_t state_hash = ZobroistHasher::get().hash_board(board);
-        state_stack.push(state_hash);
+        board.do_move_no_flag<is_white>(move);
+        assert(board.get_hash() == ZobroistHasher::get().hash_board(board));
+        state_stack.push(board.get_hash());
     }
     void make_move(Move move) {
         assert(move.is_valid());
@@ -106,13 +179,19 @@ class Game {
             make_move_no_flag<false>(move);
     }
     /**
-     * @brief Assumes move is flagged.
+     * @brief Makes a move in the search. Assumes move is flagged.
      *
      * @tparam is_white true if white
      * @param[in] move move
+     * @param[in] ply ply the move is made from. Its search stack entry keeps what takes it back.
+     */
+    template <bool is_white> void make_move(Move move, int ply);
+    template <bool is_white> void undo_move(int ply);
+    /**
+     * @brief Passes the turn, see Board::do_null_move. Undo with undo_null_move.
      */
-    template <bool is_white> void make_move(Move move);
-    template <bool is_white> void undo_move();
+    void make_null_move(int ply);
+    void undo_null_move(int ply);
     /**
      * @brief Prints board to console. Uppercase pieces are white, lowercase black.
      *
@@ -137,31 +216,106 @@ class Game {
      */
     void reset_infos();
 
-    std::queue<InfoMsg> info_queue;
+    /**
+     * @brief Sets number of search threads (UCI option Threads). The main thread is one of them,
+     * the rest are helper searchers (lazy SMP) that share the transposition table.
+     *
+     * @param[in] num_threads total number of search threads. At least 1.
+     */
+    void set_threads(int num_threads);
+    int get_threads() const { return helpers.size() + 1; }
+
+    /**
+     * @brief Reallocates the transposition table (UCI option Hash). Clears it.
+     *
+     * @param[in] size_MB size of table in MB.
+     */
+    void set_hash_size(size_t size_MB) { trans_table->resize(size_MB); }
+    size_t get_hash_size() const { return trans_table->get_size_MB(); }
+    bool uses_huge_pages() const { return trans_table->uses_huge_pages(); }
+
+    // Filled by the searching thread, emptied by the thread printing info. Messages that find it full are dropped, except
+    // the last iteration's, see push_final_info.
+    spsc_queue<InfoMsg, INFO_QUEUE_SIZE> info_queue;
 
  private:
-    std::array<std::array<Move, max_legal_moves>, 64> move_arr;
-    std::stack<Move> move_stack;
-    std::stack<restore_move_info> restore_info_stack;
+    std::array<std::array<Move, max_legal_moves>, MAX_PLY> move_arr;
+    std::array<search_stack_entry, MAX_PLY + 1> search_stack;
+    MoveOrder::history_table history = {};
     /**
      * @brief Clear stack and pushes current board state onto it.
      *
      */
     void reset_state_stack();
-    StateStack state_stack;
+    StateStack state_stack;  // Hashes of the game up to the root, for repetitions.
     Move bestmove;
     Board board;
     uint64_t moves_generated;
-    uint64_t nodes_evaluated;
+    std::atomic<uint64_t> nodes_evaluated;  // Read by the main thread while helpers search.
     int seldepth = 0;
-    std::shared_ptr<TimeManager> time_manager;
+    uint64_t reverse_futility_prunes = 0;
+    uint64_t futility_prunes = 0;
+    uint64_t delta_prunes = 0;
+    uint64_t allocations = 0;  // Heap allocations made by this thread inside alpha_beta.
+    pawn_table pawns;
+    eval_cache evals;
+    std::shared_ptr<TimeManager> time_manager;  // Only replaced by the searching thread, while holding signal_mutex.
+    std::mutex signal_mutex;                     // Guards time_manager against stop and ponderhit from other threads.
+    bool stop_signal = false;
+    bool ponderhit_signal = false;
+    uint64_t node_limit = 0;  // Nodes of all threads after which the main thread stops the search. 0 for none.
     Game() = default;
+    /**
+     * @brief Constructor for helper search threads. They share the transposition table of the main
+     * thread.
+     *
+     * @param[in] shared_table transposition table of the main thread.
+     * @param[in] id helper id. 1 and up.
+     */
+    Game(std::shared_ptr<transposition_table> shared_table, int id) : helper_id(id), trans_table(shared_table) {}
     static constexpr int INF = 10000000;
-    std::unique_ptr<transposition_table> trans_table = std::make_unique<transposition_table>();
+    static constexpr int max_depth = 256;
+    int helper_id = 0;  // 0 for the main thread.
+    std::shared_ptr<transposition_table> trans_table = std::make_shared<transposition_table>();
+    std::vector<std::unique_ptr<Game>> helpers;
+    std::vector<std::thread> helper_threads;
+    int completed_depth = 0;  // Deepest fully searched iteration.
+    Move root_bestmove;       // Best root move so far in the current (possibly unfinished) iteration.
     /**
      * @brief Main game logic loop for thinking about a position.
      *
      */
     bool one_depth_complete;
-    template <bool is_white> void think_loop(const time_control rem_time);
+    template <bool is_white> void think_loop(const search_limits &limits);
+    /**
+     * @brief Info of the search so far: nodes, time, pv, seldepth and hashfull. Score is left for
+     * the caller.
+     *
+     * @param[in] depth depth of iteration.
+     */
+    template <bool is_white> InfoMsg iteration_info(int depth);
+    /**
+     * @brief Queues an info string. Dropped if the queue is full.
+     */
+    void push_string(const std::string &string);
+    /**
+     * @brief Queues the info of the last iteration after it found the queue full, waiting up to
+     * INFO_FINAL_WAIT_MS for the printing thread to make room. Without one, as in bench, it is
+     * dropped after that.
+     */
+    void push_final_info(const InfoMsg &msg);
+    /**
+     * @brief Copies the position into the helpers and launches one thread per helper. The helpers
+     * search until the time manager tells them to stop.
+     */
+    template <bool is_white> void start_helpers();
+    /**
+     * @brief Stops and joins helpers. Picks the bestmove of the thread that completed the
+     * deepest iteration, main thread wins ties.
+     */
+    void stop_helpers();
+    /**
+     * @brief Iterative deepening loop of a helper thread. Sends no info.
+     */
+    template <bool is_white> void helper_loop();
 };
@@ -5,6 +5,7 @@
 #include <notation_interface.h>
 #include <piece.h>
 
+#include <bit>
 #include <cstdint>
 #include <string>
 using Flag_t = uint8_t;
@@ -32,9 +33,10 @@ inline constexpr bool is_promotion(Flag_t flag) {
 }
 }  // namespace moveflag
 struct Move {
-    Flag_t flag : 4 = 0;
-    uint8_t source : 6 = 0;
-    uint8_t target : 6 = 0;
+    // uint16_t fields keep the move in two bytes, so it converts to and from 16 bits for free.
+    uint16_t flag : 4 = 0;
+    uint16_t source : 6 = 0;
+    uint16_t target : 6 = 0;
 
     inline constexpr bool is_promotion() { return moveflag::is_promotion(flag); }
     inline constexpr Piece_t get_promotion() {
@@ -111,8 +113,14 @@ struct Move {
         return out;
     }
     constexpr inline bool is_valid() { return (source != target); }
+    /**
+     * @brief Packs the move into 16 bits: flag [0, 4), source [4, 10), target [10, 16).
+     */
+    constexpr inline uint16_t to_bits() const { return std::bit_cast<uint16_t>(*this); }
+    static constexpr Move from_bits(uint16_t bits) { return std::bit_cast<Move>(bits); }
     constexpr inline bool operator==(const Move &other) const { return (source == other.source) && (target == other.target) && (flag == other.flag); }
     constexpr Move() {}
 };
+static_assert(sizeof(Move) == 2, "Move must fit in 16 bits");
 
 #endif
@@ -1,7 +1,9 @@
 // Copyright 2025 Filip Agert
 #ifndef MOVEGEN_H
 #define MOVEGEN_H
+#include <array>
 #include <bitboard.h>
+#include <immintrin.h>
 #include <notation_interface.h>
 struct pininfo {
     uint8_t kingloc;
@@ -10,9 +12,18 @@ struct pininfo {
     BB rook_pinners;
     BB bishop_pinners;
 };
+struct checkinfo {
+    uint8_t enemy_kingloc;
+    std::array<BB, 7> direct_checks;  // Squares from which each piece type attacks the enemy king, indexed by piece type.
+    BB discoverers;                   // Own pieces alone between an own slider and the enemy king.
+    BB discovery_sliders;             // The sliders behind the discoverers.
+};
 struct search_type {
     bool normal_search : 1;
     bool quiesence_search : 1;
+    bool tactical_search : 1;     // Captures, en passant and promotions.
+    bool quiet_search : 1;        // Everything tactical_search does not generate.
+    bool quiet_check_search : 1;  // The quiet_search moves that give check.
 };
 struct check_type {
     bool no_check : 1;
@@ -21,8 +32,11 @@ struct check_type {
     bool slider_check : 1;
 };
 
-constexpr search_type normal_search = {true, false};
-constexpr search_type quiesence_search = {false, true};
+constexpr search_type normal_search = {true, false, false, false, false};
+constexpr search_type quiesence_search = {false, true, false, false, false};
+constexpr search_type tactical_search = {false, false, true, false, false};
+constexpr search_type quiet_search = {false, false, false, true, false};
+constexpr search_type quiet_check_search = {false, false, false, false, true};
 constexpr check_type no_check = {true, false, false, false};
 constexpr check_type single_check = {false, true, false, false};
 constexpr check_type slider_check = {false, true, false, true};
@@ -59,6 +73,44 @@ constexpr std::array<uint8_t, 64> rook_magic_sizes_bits = {12, 11, 11, 11, 11, 1
 //                   48 49                          56
 constexpr std::array<uint8_t, 64> bishop_magic_sizes_bits = {6, 5, 5, 5, 5, 5, 5, 6, 5, 5, 5, 5, 5, 5, 5, 5, 5, 5, 7, 7, 7, 7, 5, 5, 5, 5, 7, 9, 9, 7, 5, 5,
                                                              5, 5, 7, 9, 9, 7, 5, 5, 5, 5, 7, 7, 7, 7, 5, 5, 5, 5, 5, 5, 5, 5, 5, 5, 6, 5, 5, 5, 5, 5, 5, 6};
+#ifdef USE_PEXT
+#ifndef __BMI2__
+#error "USE_PEXT needs a target with BMI2, e.g. -march=native on a CPU that has it."
+#endif
+/**
+ * @brief Bits of the slider tables per square. PEXT indexes by the relevant occupancy bits
+ * themselves, so every square needs all 2^bits entries. The denser magic sizes do not apply.
+ */
+constexpr std::array<uint8_t, 64> rook_table_bits = [] {
+    std::array<uint8_t, 64> bits;
+    for (int i = 0; i < 64; i++)
+        bits[i] = rook_num_occ_bits[i];
+    return bits;
+}();
+constexpr std::array<uint8_t, 64> bishop_table_bits = [] {
+    std::array<uint8_t, 64> bits;
+    for (int i = 0; i < 64; i++)
+        bits[i] = bishop_num_occ_bits[i];
+    return bits;
+}();
+/**
+ * @brief Parallel bits extract: the bits of bb under mask, packed into the low bits. The loop is
+ * only used in constant evaluation, at runtime it is one instruction.
+ */
+constexpr uint64_t pext(uint64_t bb, uint64_t mask) {
+    if consteval {
+        uint64_t out = 0;
+        for (int bit = 0; mask; mask &= mask - 1, bit++)
+            out |= static_cast<uint64_t>((bb & mask & -mask) != 0) << bit;
+        return out;
+    } else {
+        return _pext_u64(bb, mask);
+    }
+}
+#else
+constexpr std::array<uint8_t, 64> rook_table_bits = rook_magic_sizes_bits;
+constexpr std::array<uint8_t, 64> bishop_table_bits = bishop_magic_sizes_bits;
+#endif
 /**
  * @brief Max bits in any magic table for any square rook or bishop.
  *
@@ -78,7 +130,7 @@ constexpr size_t max_size = 1 << (max_bits);  // 2^12
 constexpr std::array<size_t, 64> rook_magic_sizes = [] {
     std::array<size_t, 64> rook_magic_sizes_temp;
     for (int i = 0; i < 64; i++) {
-        rook_magic_sizes_temp[i] = (1 << rook_magic_sizes_bits[i]);
+        rook_magic_sizes_temp[i] = (1 << rook_table_bits[i]);
     }
     return rook_magic_sizes_temp;
 }();
@@ -86,7 +138,7 @@ constexpr std::array<size_t, 64> rook_magic_sizes = [] {
 constexpr std::array<size_t, 64> bishop_magic_sizes = [] {
     std::array<size_t, 64> bishop_magic_sizes_temp;
     for (int i = 0; i < 64; i++) {
-        bishop_magic_sizes_temp[i] = (1 << bishop_magic_sizes_bits[i]);
+        bishop_magic_sizes_temp[i] = (1 << bishop_table_bits[i]);
     }
     return bishop_magic_sizes_temp;
 }();
@@ -109,9 +161,12 @@ alignas(64) constexpr std::array<uint8_t, 64> bishop_magic_shifts = [] {  // the
     return bishop_magic_shifts;
 }();
 /**
- * @brief Offset caused by flattening 2D array [64][nbits] into 1D. Each square has its own offset
- * to start its indexing from.
+ * @brief Offset of each square's table in the shared slider table. Rook tables come first, bishop
+ * tables follow them in the same array, so both lookups share one base address.
  *
+ * gen_magics pack tries to overlap the tables, placing each where its used keys only meet unused
+ * or equal entries. The magics below fill their tables almost completely, so nothing overlaps and
+ * the tables are laid out back to back. If the packer finds a smaller layout, put its offsets here.
  */
 alignas(64) constexpr std::array<size_t, 64> rook_magic_offsets = [] {
     std::array<size_t, 64> offsets;
@@ -120,22 +175,19 @@ alignas(64) constexpr std::array<size_t, 64> rook_magic_offsets = [] {
         offsets[i] = offsets[i - 1] + rook_magic_sizes[i - 1];
     }
     return offsets;
-}();  // ofset for 1d flattened array
+}();
 alignas(64) constexpr std::array<size_t, 64> bishop_magic_offsets = [] {
     std::array<size_t, 64> offsets;
-    offsets[0] = 0;
+    offsets[0] = rook_magic_offsets[63] + rook_magic_sizes[63];
     for (int i = 1; i < 64; i++) {
         offsets[i] = offsets[i - 1] + bishop_magic_sizes[i - 1];
     }
     return offsets;
-}();  // ofset for 1d flattened array
+}();
 /**
- * @brief Size of rook table.
- *
- * @return [TODO:description]
+ * @brief Number of entries in the shared slider table.
  */
-constexpr size_t rook_magic_table_sz = rook_magic_offsets[63] + rook_magic_sizes[63];
-constexpr size_t bishop_magic_table_sz = bishop_magic_offsets[63] + bishop_magic_sizes[63];
+constexpr size_t slider_table_sz = bishop_magic_offsets[63] + bishop_magic_sizes[63];
 /**
  * @brief All rook magic numbers.
  *
@@ -341,17 +393,22 @@ constexpr std::array<uint64_t, 64> bishop_occupancy_table = [] {
     return arr;
 }();  // Will be used as a key for magic bitboard.
 /**
- * @brief Gets the key for the rook magic bitboard table.
+ * @brief Gets the key for the rook magic bitboard table. With USE_PEXT the relevant occupancy
+ * bits are gathered by one pext instead of the multiply and shift.
  *
  * @param[in] sq Square of rook
  * @param[in] occ occupancy bitboard (all pieces)
  * @return the key to lookup the magic bitboard with.
  */
 constexpr uint64_t get_rook_key(const uint8_t sq, const uint64_t occ) {
+#ifdef USE_PEXT
+    return pext(occ, rook_occupancy_table[sq]);
+#else
     uint8_t shift = rook_magic_shifts[sq];
     uint64_t magic = rook_magics[sq];
     uint64_t occmask = rook_occupancy_table[sq];
     return (((occmask & occ) * magic) >> shift);
+#endif
 }
 /**
  * @brief Gets the key for the bishop magic bitboard table.
@@ -361,26 +418,30 @@ constexpr uint64_t get_rook_key(const uint8_t sq, const uint64_t occ) {
  * @return the key to lookup the magic bitboard with.
  */
 inline constexpr uint64_t get_bishop_key(const uint8_t sq, const uint64_t occ) {
+#ifdef USE_PEXT
+    return pext(occ, bishop_occupancy_table[sq]);
+#else
     uint8_t shift = bishop_magic_shifts[sq];
     uint64_t magic = bishop_magics[sq];
     uint64_t occmask = bishop_occupancy_table[sq];
     return (((occmask & occ) * magic) >> shift);
+#endif
 }
 /**
  * @brief Gets the index to access the flattened rook bitboard array with.
  *
  * @param[in] sq square of rook
  * @param[in] occ occupancy bitboard (can be unmasked.)
- * @return index to access array rook_magic_bitboards with.
+ * @return index to access slider_attacks with.
  */
 inline constexpr int get_rook_magic_idx(const uint8_t sq, const uint64_t occ) { return get_rook_key(sq, occ) + rook_magic_offsets[sq]; }
 inline constexpr int get_bishop_magic_idx(const uint8_t sq, const uint64_t occ) { return get_bishop_key(sq, occ) + bishop_magic_offsets[sq]; }
 /**
- * @brief Table of rook magic bitboards. Indexed by the function get_rook_magic_idx
+ * @brief Shared table of rook and bishop attack bitboards. Indexed by the functions
+ * get_rook_magic_idx and get_bishop_magic_idx.
  *
  */
-alignas(64) extern const std::array<uint64_t, rook_magic_table_sz> rook_magic_bitboards;
-alignas(64) extern const std::array<uint64_t, bishop_magic_table_sz> bishop_magic_bitboards;
+alignas(64) extern const std::array<uint64_t, slider_table_sz> slider_attacks;
 /**
  * @brief Gets all the squares the rook can reach from the given position given an occupancy of the
  * board stored in the occ bitboard. Needs to be masked with friendly pieces to not capture them.
@@ -389,17 +450,17 @@ alignas(64) extern const std::array<uint64_t, bishop_magic_table_sz> bishop_magi
  * @param[in] occ Occupancy bitboard for hess board
  * @return All attackable squares for the rook at sq.
  */
-inline constexpr BB get_rook_atk_bb(const uint8_t sq, const uint64_t occ) { return rook_magic_bitboards[get_rook_magic_idx(sq, occ)]; }
-inline constexpr BB get_bishop_atk_bb(const uint8_t sq, const uint64_t occ) { return bishop_magic_bitboards[get_bishop_magic_idx(sq, occ)]; }
+inline constexpr BB get_rook_atk_bb(const uint8_t sq, const uint64_t occ) { return slider_attacks[get_rook_magic_idx(sq, occ)]; }
+inline constexpr BB get_bishop_atk_bb(const uint8_t sq, const uint64_t occ) { return slider_attacks[get_bishop_magic_idx(sq, occ)]; }
 inline constexpr BB get_rook_xray_atk_bb(const uint8_t sq, const uint64_t occ) {
-    BB atk1 = rook_magic_bitboards[get_rook_magic_idx(sq, occ)];
+    BB atk1 = slider_attacks[get_rook_magic_idx(sq, occ)];
     BB occ2 = occ & ~atk1;  // Remove first blockers.
-    return rook_magic_bitboards[get_rook_magic_idx(sq, occ2)];
+    return slider_attacks[get_rook_magic_idx(sq, occ2)];
 }
 inline constexpr BB get_bishop_xray_atk_bb(const uint8_t sq, const BB occ) {
-    BB atk1 = bishop_magic_bitboards[get_bishop_magic_idx(sq, occ)];
+    BB atk1 = slider_attacks[get_bishop_magic_idx(sq, occ)];
     BB occ2 = occ & ~atk1;  // Remove first blockers.
-    return bishop_magic_bitboards[get_bishop_magic_idx(sq, occ2)];
+    return slider_attacks[get_bishop_magic_idx(sq, occ2)];
 }
 }  // namespace magic
 
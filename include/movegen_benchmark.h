@@ -2,7 +2,44 @@
 #ifndef MOVEGEN_BENCHMARK_H
 #define MOVEGEN_BENCHMARK_H
 #include <board.h>
+#include <optional>
 #include <string>
+#include <tables.h>
+#include <vector>
+
+/**
+ * @brief Hash table of perft node counts keyed on (hash, depth). Transposed subtrees are only
+ * counted once. Lockless in the same way as the transposition table, so it can be shared by all
+ * perft threads.
+ */
+class perft_table {
+ public:
+    /**
+     * @brief Allocates a table of at most size_MB megabytes, rounded down to a power of two slots.
+     *
+     * @param[in] size_MB size of table in MB (2^20 bytes).
+     */
+    explicit perft_table(size_t size_MB);
+    /**
+     * @brief Gets number of leaf nodes below a position.
+     *
+     * @param[in] hash hash of board.
+     * @param[in] depth remaining depth.
+     * @return node count if stored.
+     */
+    std::optional<uint64_t> get(uint64_t hash, int depth) const;
+    void store(uint64_t hash, int depth, uint64_t nodes);
+
+ private:
+    /**
+     * @brief Mixes the depth into the hash so the same position at different depths gets
+     * different keys.
+     */
+    static constexpr uint64_t depth_key(uint64_t hash, int depth) { return hash ^ (depth * 0x9E3779B97F4A7C15ULL); }
+    std::vector<transposition_slot> arr;  // key = depth_key ^ nodes, data = nodes
+    uint64_t mask;
+};
+
 /**
  * @brief Class to assist with testing of movement generation. Timing movegeneration and for
  * checking number of moves from a state.
@@ -18,11 +55,43 @@ class movegen_benchmark {
      * printing. Default = -1.
      * @return Number of moves at this depth.
      */
-    static int gen_num_moves(std::string FEN, int depth, int print_depth = -1);
-    static int gen_num_moves(Board board, int depth, int print_depth = -1);
+    static uint64_t gen_num_moves(std::string FEN, int depth, int print_depth = -1);
+    static uint64_t gen_num_moves(Board board, int depth, int print_depth = -1);
+    /**
+     * @brief Multithreaded perft. The tree is split into subtrees two plies below the root, which
+     * the threads pick from a shared queue until it is empty.
+     *
+     * @param[in] board Board to start from
+     * @param[in] depth Depth counts for half ply.
+     * @param[in] threads Number of threads.
+     * @param[in] hash_MB Size of perft hash table in MB shared by the threads. 0 for no table.
+     * @param[in] print_root If true, prints number of moves found in each root branch.
+     * @return Number of moves at this depth.
+     */
+    static uint64_t gen_num_moves_parallel(Board board, int depth, int threads, size_t hash_MB = 0, bool print_root = false);
+    /**
+     * @brief Microbenchmark of move ordering. Collects the move lists and heuristic scores of all
+     * interior nodes down to depth, then times MoveOrder::partial_move_sort on them. Each list is
+     * copied to a scratch buffer before sorting; the time of copying alone is subtracted.
+     *
+     * @param[in] board Board to start from
+     * @param[in] depth Depth of tree to collect move lists from.
+     * @return average time to sort one move list in ns.
+     */
+    static int64_t sort_benchmark(Board board, int depth);
 
  private:
-    template <bool is_white> static int recurse_moves(Board board, int print_depth, int curr_depth, int to_depth);
-    static std::array<std::array<Move, max_legal_moves>, 32> move_arr;
+    static constexpr int max_depth = 32;
+    using move_buffer = std::array<std::array<Move, max_legal_moves>, max_depth>;
+    template <bool is_white>
+    static uint64_t recurse_moves(Board &board, move_buffer &move_arr, perft_table *table, int print_depth, int curr_depth, int to_depth);
+    template <bool is_white> static uint64_t gen_num_moves_parallel(Board &board, int depth, int threads, size_t hash_MB, bool print_root);
+    // All move lists back to back, list i is [offsets[i], offsets[i + 1]).
+    struct scored_move_lists {
+        std::vector<Move> moves;
+        std::vector<int> scores;
+        std::vector<size_t> offsets = {0};
+    };
+    template <bool is_white> static void collect_move_lists(Board &board, int depth, scored_move_lists &lists);
 };
 #endif
@@ -3,10 +3,59 @@
 
 #include "eval.h"
 #include <board.h>
+#include <cstdint>
 #include <move.h>
 #include <optional>
 #include <utility>
 namespace MoveOrder {
+/**
+ * @brief Butterfly history of quiet moves, indexed [is_white][from][to]. Raised for moves causing a
+ * beta cutoff and lowered for the quiet moves searched before them.
+ */
+using history_table = std::array<std::array<std::array<int, 64>, 64>, 2>;
+constexpr int max_history = 1 << 14;
+/**
+ * @brief Adds bonus to a history entry. The closer the entry is to +-max_history, the less it
+ * moves, so it never leaves the range and recent cutoffs still matter.
+ *
+ * @param[inout] entry history entry
+ * @param[in] bonus bonus, negative for a penalty. At most max_history in magnitude.
+ */
+constexpr inline void update_history(int &entry, int bonus) { entry += bonus - entry * (bonus < 0 ? -bonus : bonus) / max_history; }
+/**
+ * @brief True if move neither captures nor promotes.
+ */
+inline bool is_quiet(Move move, const Board &board) {
+    return board.is_square_empty(move.target) && !move.is_promotion() && move.flag != moveflag::MOVEFLAG_pawn_ep_capture;
+}
+
+/**
+ * @brief A move and its score packed into one integer: score in the upper bits, move (Move::to_bits)
+ * in the lower 16. Comparing packed values compares scores, so moves are sorted by sorting plain
+ * integers.
+ */
+using scored_move = int64_t;
+constexpr inline scored_move pack(Move move, int score) { return static_cast<scored_move>(score) * (1 << 16) + move.to_bits(); }
+constexpr inline Move unpack(scored_move packed) { return Move::from_bits(static_cast<uint16_t>(packed & 0xFFFF)); }
+
+/**
+ * @brief Sorts packed moves by descending score with insertion sort, in place. Stable, so moves
+ * with equal scores keep their generation order.
+ *
+ * @param[inout] packed packed moves
+ * @param[in] start first index to sort
+ * @param[in] num_moves end of range to sort
+ */
+constexpr inline void insertion_sort(std::array<scored_move, max_legal_moves> &packed, size_t start, size_t num_moves) {
+    for (size_t i = start + 1; i < num_moves; i++) {
+        scored_move val = packed[i];
+        size_t j = i;
+        for (; j > start && (packed[j - 1] >> 16) < (val >> 16); j--)
+            packed[j] = packed[j - 1];
+        packed[j] = val;
+    }
+}
+
 void partial_move_sort(std::array<Move, max_legal_moves> &moves,
                        std::array<int, max_legal_moves> &scores, size_t start, size_t num_moves,
                        bool ascending);
@@ -0,0 +1,150 @@
+// Copyright 2025 Filip Agert
+#ifndef MOVEPICKER_H
+#define MOVEPICKER_H
+#include <array>
+#include <board.h>
+#include <eval.h>
+#include <move.h>
+#include <moveorder.h>
+#include <optional>
+
+/**
+ * @brief Yields the moves of a position in stages: TT move, captures and promotions by MVV-LVA,
+ * killers, quiet moves, captures losing material by static exchange evaluation. Each stage is only
+ * generated once the previous one is exhausted, and moves are picked by selection, so a node that
+ * cuts off early never generates or sorts the rest.
+ *
+ * @tparam is_white color to move.
+ */
+template <bool is_white> class MovePicker {
+ public:
+    /**
+     * @param[in] board board to generate moves for. Must not change while picking.
+     * @param[in] moves storage for the generated moves, usually Game::move_arr[ply].
+     * @param[in] tt_move move from transposition table. Assumed legal.
+     * @param[in] killers quiet moves that caused cutoffs at this ply. Only yielded if legal.
+     * @param[in] history butterfly history to order the remaining quiet moves by. May be null.
+     */
+    MovePicker(Board &board, std::array<Move, max_legal_moves> &moves, std::optional<Move> tt_move, std::array<Move, 2> killers = {},
+               const MoveOrder::history_table *history = nullptr)
+        : board(board), moves(moves), tt_move(tt_move.value_or(Move())), killers(killers), history(history) {}
+
+    /**
+     * @brief Gets next move.
+     *
+     * @param[out] move next move
+     * @return false if there are no moves left.
+     */
+    bool next(Move &move) {
+        switch (stage) {
+        case stage_tt:
+            stage = stage_gen_tactical;
+            if (tt_move.is_valid()) {
+                move = tt_move;
+                return true;
+            }
+            [[fallthrough]];
+        case stage_gen_tactical:
+            end = board.template get_moves<tactical_search, is_white>(moves.data());
+            for (size_t i = 0; i < end; i++)
+                scored[i] = MoveOrder::pack(moves[i], mvv_lva(moves[i]));
+            stage = stage_tactical;
+            [[fallthrough]];
+        case stage_tactical:
+            if (select<true>(move))
+                return true;
+            stage = stage_gen_quiet;
+            [[fallthrough]];
+        case stage_gen_quiet:
+            end += board.template get_moves<quiet_search, is_white>(moves.data() + end);
+            for (size_t i = curr; i < end; i++) {
+                int score = MoveOrder::move_heuristics<is_white>(moves[i], board);
+                if (history)
+                    score += (*history)[is_white][moves[i].source][moves[i].target];
+                if (moves[i] == killers[0])
+                    score = killer_score + 1;
+                else if (moves[i] == killers[1])
+                    score = killer_score;
+                scored[i] = MoveOrder::pack(moves[i], score);
+            }
+            stage = stage_quiet;
+            [[fallthrough]];
+        case stage_quiet:
+            if (select<false>(move))
+                return true;
+            stage = stage_losing;
+            curr = 0;
+            [[fallthrough]];
+        case stage_losing:
+            if (curr < num_losing) {
+                move = MoveOrder::unpack(scored[curr++]);
+                return true;
+            }
+            stage = stage_done;
+            [[fallthrough]];
+        case stage_done:
+            return false;
+        }
+        return false;
+    }
+
+ private:
+    enum stage_t { stage_tt, stage_gen_tactical, stage_tactical, stage_gen_quiet, stage_quiet, stage_losing, stage_done };
+    static constexpr int killer_score = 1 << 20;  // Above any quiet heuristic and history score.
+    // Least valuable attacker first: pawn, knight, bishop, rook, queen, king. Indexed by piece type.
+    static constexpr std::array<int, 7> attacker_order = {0, 6, 5, 4, 2, 3, 1};
+
+    Board &board;
+    std::array<Move, max_legal_moves> &moves;
+    std::array<MoveOrder::scored_move, max_legal_moves> scored;  // moves packed with their score.
+    Move tt_move;
+    std::array<Move, 2> killers;
+    const MoveOrder::history_table *history;
+    stage_t stage = stage_tt;
+    size_t curr = 0;        // next move to pick.
+    size_t end = 0;         // end of generated moves.
+    size_t num_losing = 0;  // losing captures, kept in order at the start of scored.
+
+    /**
+     * @brief Score of capture or promotion. Most valuable victim first, then least valuable
+     * attacker.
+     */
+    int mvv_lva(Move move) {
+        int score = 0;
+        if (move.flag == moveflag::MOVEFLAG_pawn_ep_capture)
+            score = PieceValue::pawn * 8;
+        else if (!board.is_square_empty(move.target))
+            score = PieceValue::piecevals[board.get_piece_at(move.target).get_type()] * 8;
+        if (move.is_promotion())
+            score += PieceValue::piecevals[move.get_promotion()];
+        return score - attacker_order[board.get_piece_at(move.source).get_type()];
+    }
+
+    /**
+     * @brief Moves the best scored remaining move to curr and yields it. Skips the TT move, which
+     * was already yielded.
+     *
+     * @tparam defer_losing if true, moves losing material are put aside for the last stage.
+     */
+    template <bool defer_losing> bool select(Move &move) {
+        while (curr < end) {
+            size_t best = curr;
+            for (size_t i = curr + 1; i < end; i++)
+                if (scored[i] > scored[best])
+                    best = i;
+            std::swap(scored[curr], scored[best]);
+            move = MoveOrder::unpack(scored[curr++]);
+            if (move == tt_move)
+                continue;
+            if constexpr (defer_losing) {
+                if (!board.see(move, 0)) {
+                    scored[num_losing++] = scored[curr - 1];  // Slots before curr are already picked.
+                    continue;
+                }
+            }
+            return true;
+        }
+        return false;
+    }
+};
+#endif
@@ -0,0 +1,120 @@
+// Copyright 2025 Filip Agert
+#ifndef NNUE_H
+#define NNUE_H
+#include <array>
+#include <cstdint>
+#include <piece.h>
+#include <string>
+
+/**
+ * @brief Efficiently updatable neural network evaluation. The network is 768 -> hidden x 2 -> 1:
+ * one input per (color, piece type, square) seen from each side, a hidden layer shared by both
+ * perspectives, clipped ReLU, and an output neuron reading the side to move's half first.
+ *
+ * The hidden layer before activation (the accumulator) is kept by the board and updated as pieces
+ * are added, removed and moved, by adding or subtracting one weight column per piece per
+ * perspective. Evaluating then only costs the output layer.
+ *
+ * The network file holds little endian int16 values in this order, without header:
+ * feature weights [768][hidden], feature biases [hidden], output weights [2 * hidden], output bias.
+ * The feature index from white's perspective is (black piece ? 384 : 0) + 64 * piece + square,
+ * with pieces ordered pawn, knight, bishop, rook, queen, king and a1 = 0. Black's perspective swaps
+ * the colors and mirrors the square vertically. Feature weights are quantised by QA, output weights
+ * by QB and the output bias by QA * QB.
+ */
+namespace nnue {
+constexpr int num_features = 768;
+constexpr int hidden = 128;
+constexpr int QA = 255;
+constexpr int QB = 64;
+constexpr int SCALE = 400;  // Output of the network in centipawns is SCALE times its float output.
+
+struct network {
+    alignas(32) std::array<int16_t, num_features * hidden> feature_weights;
+    alignas(32) std::array<int16_t, hidden> feature_bias;
+    alignas(32) std::array<int16_t, 2 * hidden> output_weights;
+    int16_t output_bias;
+};
+inline network net = {};
+inline bool loaded = false;   // A network has been read.
+inline bool use = true;       // UCI option UseNNUE.
+inline bool enabled = false;  // loaded && use. Boards only keep accumulators, and eval only uses the network, while set.
+
+/**
+ * @brief Reads a network file and enables the network if UseNNUE is set.
+ *
+ * @param[in] path path to network file.
+ * @return false if the file could not be read or has the wrong size. The previous network is kept.
+ */
+bool load(const std::string &path);
+/**
+ * @brief Sets the UseNNUE option.
+ */
+void set_use(bool use_nnue);
+
+// Feature order of the network, indexed by our piece type (none, king, queen, rook, knight, bishop, pawn).
+constexpr std::array<int, 7> piece_order = {0, 5, 4, 3, 1, 2, 0};
+/**
+ * @brief Index of the input of a piece on a square.
+ *
+ * @tparam perspective_white side the input is seen from.
+ */
+template <Piece_t type, bool is_white, bool perspective_white> constexpr int feature(uint8_t sq) {
+    if constexpr (perspective_white)
+        return (is_white ? 0 : 384) + 64 * piece_order[type] + sq;
+    else
+        return (is_white ? 384 : 0) + 64 * piece_order[type] + (sq ^ 56);
+}
+
+/**
+ * @brief Hidden layer of both perspectives before activation, indexed by is_white.
+ */
+struct accumulator {
+    alignas(32) std::array<std::array<int16_t, hidden>, 2> values;
+
+    void reset() { values[0] = values[1] = net.feature_bias; }
+    template <Piece_t type, bool is_white> void add(uint8_t sq) {
+        add_column(values[true], feature<type, is_white, true>(sq));
+        add_column(values[false], feature<type, is_white, false>(sq));
+    }
+    template <Piece_t type, bool is_white> void remove(uint8_t sq) {
+        sub_column(values[true], feature<type, is_white, true>(sq));
+        sub_column(values[false], feature<type, is_white, false>(sq));
+    }
+    template <Piece_t type, bool is_white> void move(uint8_t source, uint8_t target) {
+        move_column(values[true], feature<type, is_white, true>(source), feature<type, is_white, true>(target));
+        move_column(values[false], feature<type, is_white, false>(source), feature<type, is_white, false>(target));
+    }
+
+ private:
+    // Plain loops over a fixed size, the compiler vectorises them.
+    static void add_column(std::array<int16_t, hidden> &acc, int f) {
+        const int16_t *w = &net.feature_weights[f * hidden];
+        for (int i = 0; i < hidden; i++)
+            acc[i] += w[i];
+    }
+    static void sub_column(std::array<int16_t, hidden> &acc, int f) {
+        const int16_t *w = &net.feature_weights[f * hidden];
+        for (int i = 0; i < hidden; i++)
+            acc[i] -= w[i];
+    }
+    static void move_column(std::array<int16_t, hidden> &acc, int from, int to) {
+        const int16_t *w_from = &net.feature_weights[from * hidden];
+        const int16_t *w_to = &net.feature_weights[to * hidden];
+        for (int i = 0; i < hidden; i++)
+            acc[i] += w_to[i] - w_from[i];
+    }
+};
+
+/**
+ * @brief Output of the network in centipawns, relative to the side to move. Uses AVX2 or SSE2 when
+ * compiled for them.
+ */
+int evaluate(const accumulator &acc, bool white_to_move);
+/**
+ * @brief Same as evaluate without SIMD. Used when neither instruction set is available, and to
+ * test the SIMD kernels against.
+ */
+int evaluate_scalar(const accumulator &acc, bool white_to_move);
+}  // namespace nnue
+#endif
@@ -0,0 +1,140 @@
+// Copyright 2025 Filip Agert
+#ifndef PSQT_H
+#define PSQT_H
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <notation_interface.h>
+#include <piece.h>
+namespace helpers {
+/**
+ * @brief Get manhattan distance between two squares
+ *
+ * @param[in] sq1 square1
+ * @param[in] sq2 square2
+ * @return manhattan distance between squares
+ */
+constexpr uint8_t manhattan(uint8_t sq1, uint8_t sq2) {
+    uint8_t r1, c1, r2, c2;
+    r1 = NotationInterface::row(sq1);
+    r2 = NotationInterface::row(sq2);
+    c1 = NotationInterface::col(sq1);
+    c2 = NotationInterface::col(sq2);
+    int rdist = static_cast<int>(r1) - static_cast<int>(r2);
+    rdist = rdist < 0 ? -rdist : rdist;
+    int cdist = static_cast<int>(c1) - static_cast<int>(c2);
+    cdist = cdist < 0 ? -cdist : cdist;
+    return rdist + cdist;
+}
+constexpr std::array<uint8_t, 64> dist2centre = [] {
+    constexpr std::array<uint8_t, 4> centre_squares = {27, 28, 35, 36};
+    std::array<uint8_t, 64> distances;
+    for (int i = 0; i < 64; i++) {
+        uint8_t dist = 64;
+        for (uint8_t c : centre_squares) {
+            dist = std::min(manhattan(c, i), dist);
+        }
+        distances[i] = dist;
+    }
+    return distances;
+}();
+/**
+ * @brief Number of squares a piece reaches from sq on an empty board.
+ */
+constexpr int empty_board_moves(Piece_t p, uint8_t sq) {
+    int r = NotationInterface::row(sq);
+    int c = NotationInterface::col(sq);
+    if (p == pieces::knight) {
+        constexpr std::array<std::array<int, 2>, 8> jumps = {{{1, 2}, {2, 1}, {2, -1}, {1, -2}, {-1, -2}, {-2, -1}, {-2, 1}, {-1, 2}}};
+        int moves = 0;
+        for (const std::array<int, 2> &j : jumps)
+            moves += r + j[0] >= 0 && r + j[0] < 8 && c + j[1] >= 0 && c + j[1] < 8;
+        return moves;
+    } else if (p == pieces::bishop) {
+        return std::min(r, c) + std::min(r, 7 - c) + std::min(7 - r, c) + std::min(7 - r, 7 - c);
+    } else if (p == pieces::king) {
+        return (1 + std::min(r, 1) + std::min(7 - r, 1)) * (1 + std::min(c, 1) + std::min(7 - c, 1)) - 1;
+    }
+    return 0;
+}
+}  // namespace helpers
+
+namespace PieceValue {
+static constexpr int king = 200000;
+static constexpr int pawn = 100;
+static constexpr int knight = 290;
+static constexpr int bishop = 300;
+static constexpr int rook = 500;
+static constexpr int queen = 900;
+static constexpr int bishop_double_bonus = 25;
+static constexpr std::array<int, 7> piecevals = {0, king, queen, rook, knight, bishop, pawn};
+
+static constexpr int inv_frac = 10;  // Fraction of extra value piece is worth extra from having more spaces to move to.
+// Formula is : piece_val * num_moves / max_possible_moves * frac
+static constexpr int pawn_moveval = 0;
+static constexpr int knight_moveval = knight / (8 * inv_frac);
+static constexpr int bishop_moveval = bishop / (14 * inv_frac);
+static constexpr int rook_moveval = rook / (14 * inv_frac);
+static constexpr int queen_moveval = 0;
+static constexpr int king_moveval = -6;
+static constexpr std::array<int, 7> movevals = {0, king_moveval, queen_moveval, rook_moveval, knight_moveval, bishop_moveval, pawn_moveval};
+
+static constexpr int king_dist2centre_value = 5;
+//
+static constexpr int passed_pawn_eval = 30;
+static constexpr int doubled_pawn_punishment = -15;
+static constexpr int solo_pawn_punishment = -15;
+
+// Game phase weight per piece type. The starting position has max_phase, bare pawns and kings 0.
+static constexpr std::array<int, 7> phase_weights = {0, 0, 4, 2, 1, 1, 0};
+static constexpr int max_phase = 24;
+};  // namespace PieceValue
+
+/**
+ * @brief Piece-square tables: material plus a positional bonus per square, for the midgame and
+ * the endgame. Scores are from white's point of view, black entries are mirrored and negated, so
+ * the board can keep the sums up to date as pieces are added, removed and moved.
+ *
+ * The positional bonus is the part of the eval that only depends on where a piece stands: knight
+ * and bishop mobility on an empty board, and the king's distance to the centre, which is a
+ * penalty in the endgame and a bonus (together with fewer squares around it) in the midgame.
+ */
+namespace psqt {
+struct tables {
+    std::array<std::array<int, 64>, 12> mg;
+    std::array<std::array<int, 64>, 12> eg;
+};
+alignas(64) constexpr tables table = [] {
+    tables t;
+    for (Piece_t p = pieces::king; p <= pieces::pawn; p++) {
+        for (uint8_t sq = 0; sq < 64; sq++) {
+            int moves = helpers::empty_board_moves(p, sq);
+            int mg = p == pieces::king ? 0 : PieceValue::piecevals[p];  // Both kings are always on the board.
+            int eg = mg;
+            if (p == pieces::king) {
+                mg += helpers::dist2centre[sq] * PieceValue::king_dist2centre_value + moves * PieceValue::king_moveval;
+                eg -= helpers::dist2centre[sq] * PieceValue::king_dist2centre_value;
+            } else {
+                mg += moves * PieceValue::movevals[p];
+                eg += moves * PieceValue::movevals[p];
+            }
+            t.mg[p - 1][sq] = mg;
+            t.eg[p - 1][sq] = eg;
+            t.mg[p + 5][sq ^ 56] = -mg;  // Black, flipped vertically.
+            t.eg[p + 5][sq ^ 56] = -eg;
+        }
+    }
+    return t;
+}();
+/**
+ * @brief Index into the tables for a piece type and color. Same layout as the zobrist keys.
+ */
+template <Piece_t p, bool is_white> constexpr uint8_t piece_idx() {
+    constexpr uint8_t col_offset = is_white ? 0 : 6;
+    return col_offset + (p - 1);
+}
+template <Piece_t p, bool is_white> constexpr int mg(uint8_t sq) { return table.mg[piece_idx<p, is_white>()][sq]; }
+template <Piece_t p, bool is_white> constexpr int eg(uint8_t sq) { return table.eg[piece_idx<p, is_white>()][sq]; }
+template <Piece_t p> constexpr int phase() { return PieceValue::phase_weights[p]; }
+}  // namespace psqt
+#endif
@@ -0,0 +1,55 @@
+// Copyright 2025 Filip Agert
+#ifndef SPSC_QUEUE_H
+#define SPSC_QUEUE_H
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <optional>
+#include <utility>
+
+/**
+ * @brief Lock free queue for exactly one producing and one consuming thread. A ring buffer of N
+ * slots: the producer only writes tail, the consumer only writes head, so neither ever waits for
+ * the other.
+ *
+ * @tparam T element type.
+ * @tparam N capacity. Power of two.
+ */
+template <typename T, size_t N> class spsc_queue {
+    static_assert(N > 0 && (N & (N - 1)) == 0, "spsc_queue capacity must be a power of two");
+
+ public:
+    /**
+     * @brief Adds an element. Producer thread only.
+     *
+     * @return false if the queue is full, the element is then dropped.
+     */
+    bool push(T value) {
+        size_t t = tail.load(std::memory_order_relaxed);
+        if (t - head.load(std::memory_order_acquire) == N)
+            return false;
+        slots[t & (N - 1)] = std::move(value);
+        tail.store(t + 1, std::memory_order_release);  // Publishes the slot to the consumer.
+        return true;
+    }
+    /**
+     * @brief Takes the oldest element. Consumer thread only.
+     *
+     * @return the element, or nothing if the queue is empty.
+     */
+    std::optional<T> pop() {
+        size_t h = head.load(std::memory_order_relaxed);
+        if (h == tail.load(std::memory_order_acquire))
+            return {};
+        T value = std::move(slots[h & (N - 1)]);
+        head.store(h + 1, std::memory_order_release);  // Hands the slot back to the producer.
+        return value;
+    }
+    bool empty() const { return head.load(std::memory_order_acquire) == tail.load(std::memory_order_acquire); }
+
+ private:
+    std::array<T, N> slots = {};
+    alignas(64) std::atomic<size_t> head = 0;  // Next slot to pop. On its own cache line, each index is written by one thread.
+    alignas(64) std::atomic<size_t> tail = 0;  // Next slot to push.
+};
+#endif
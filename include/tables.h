@@ -3,15 +3,21 @@
 #define TABLES_H
 
 #include <algorithm>
+#include <atomic>
 #include <bitboard.h>
 #include <board.h>
 #include <cassert>
 #include <cmath>
+#include <config.h>
 #include <cstdint>
+#include <cstdlib>
+#include <memory>
+#include <optional>
 #include <piece.h>
 #include <random>
 #include <stack>
 #include <vector>
+#include <zobrist.h>
 /**
  * @brief Class for storing the occured game states for checking 3 move repetion draws.
  */
@@ -70,33 +76,72 @@ class StateStack {
 };
 
 struct transposition_entry {
-    static constexpr int keep_hashbits = 48;
-    static constexpr int shift_hash = 64 - 48;
-    uint64_t hash : keep_hashbits = 0;
-    // Why 48? because the key contains part of the hash anyway. 64-48 = 16 bits minimum in key for this to not destroy information.
-    // Key uses rightmost bits, so
-    // this must use the leftmost bits.
+    uint64_t hash = 0;
     uint8_t nodetype = invalid;
     uint8_t depth = 0;  // to what depth was this move searched? Can only accept if our depth is
-    int eval = 0;       // Integrated bounds and values. 4n = exact eval n. 4n + 1 = a lower bound. 4n -
+                        // same or shallower.
+    int eval = 0;
     Move bestmove = Move();
-    // 1 = an upper bound.
-    // same or shallower.
+    uint8_t age = 0;  // search generation the entry was written in.
     inline bool is_valid_move() { return (bestmove.source != bestmove.target); }
 
     bool is_exact() { return nodetype == exact; }
     bool is_lb() { return nodetype == lb; }
     bool is_ub() { return nodetype == ub; }
     enum nodetype { exact, lb, ub, invalid };
+    static constexpr uint8_t age_mask = 0b111111;
+
+    /**
+     * @brief Packs everything except the hash into one word. Layout: move [0, 16), eval [16, 48),
+     * depth [48, 56), nodetype [56, 58), age [58, 64).
+     *
+     * @return packed entry data
+     */
+    constexpr uint64_t pack() const {
+        return bestmove.to_bits() | (static_cast<uint64_t>(static_cast<uint32_t>(eval)) << 16) | (static_cast<uint64_t>(depth) << 48) |
+               (static_cast<uint64_t>(nodetype & 0b11) << 56) | (static_cast<uint64_t>(age & age_mask) << 58);
+    }
+    static constexpr transposition_entry unpack(uint64_t hash, uint64_t data) {
+        Move move = Move::from_bits(static_cast<uint16_t>(data));
+        return {hash,
+                static_cast<uint8_t>((data >> 56) & 0b11),
+                static_cast<uint8_t>(data >> 48),
+                static_cast<int32_t>(static_cast<uint32_t>(data >> 16)),
+                move,
+                static_cast<uint8_t>(data >> 58)};
+    }
 };
 constexpr transposition_entry nullentry = {0, transposition_entry::invalid, 0, 0, Move(0, 0)};  // transposition_entry{0, Move(0, 0), 0, 4, 0};
 
+/**
+ * @brief A slot in the transposition table. Stores (hash ^ data, data) so that a reader that sees
+ * a half written slot (another search thread writing at the same time) fails the hash check
+ * instead of getting a mix of two entries. No locks needed.
+ */
+struct transposition_slot {
+    std::atomic<uint64_t> key;  // hash ^ data
+    std::atomic<uint64_t> data;
+};
+
+/**
+ * @brief One cache line of slots. A position may be stored in any slot of its bucket, so a probe
+ * touches a single cache line.
+ */
+struct alignas(64) transposition_bucket {
+    static constexpr int num_slots = 4;
+    std::array<transposition_slot, num_slots> slots;
+};
+static_assert(sizeof(transposition_bucket) == 64);
+/**
+ * @brief Frees memory from std::aligned_alloc. The buckets are trivially destructible.
+ */
+struct aligned_bucket_deleter {
+    void operator()(transposition_bucket *ptr) const { std::free(ptr); }
+};
+
 class ZobroistHasher {
  private:
-    ZobroistHasher() {
-        initialize_engine();
-        randomize_local_vars();
-    }
+    ZobroistHasher() { initialize_engine(); }
 
     std::uniform_int_distribution<uint64_t> generator;
     std::mt19937_64 engine;
@@ -107,7 +152,6 @@ class ZobroistHasher {
      * @return random uint64_t
      */
     void initialize_engine();
-    void randomize_local_vars();
 
  public:
     static ZobroistHasher &get() {
@@ -115,10 +159,11 @@ class ZobroistHasher {
         return instance;
     }
 
-    std::array<std::array<uint64_t, 64>, 12> piece_numbers;  // one number for each piece and square
-    std::array<uint64_t, 16> castle_numbers;                 // one for each castle combination
-    std::array<uint64_t, 8> ep_numbers;                      // file of ep
-    uint64_t black_number;                                   // indicate if black is playing or not.
+    // The keys are shared with Board, which keeps its hash up to date incrementally.
+    static constexpr const std::array<std::array<uint64_t, 64>, 12> &piece_numbers = zobrist::table.piece_numbers;  // one number for each piece and square
+    static constexpr const std::array<uint64_t, 16> &castle_numbers = zobrist::table.castle_numbers;                // one for each castle combination
+    static constexpr const std::array<uint64_t, 8> &ep_numbers = zobrist::table.ep_numbers;                         // file of ep
+    static constexpr const uint64_t &black_number = zobrist::table.black_number;  // indicate if black is playing or not.
     /**
      * @brief Adds to hash for a piece
      *
@@ -129,12 +174,9 @@ class ZobroistHasher {
      */
     template <Piece_t p, bool is_white> void hash_piece(uint64_t &hash, const Board &board);
     template <Piece_t p> void hash_both_piece(uint64_t &hash, const Board &board);
-    template <Piece_t p, bool is_white> constexpr static uint8_t piece_key() {
-        uint8_t col_offset = is_white ? 0 : 6;
-        return col_offset + (p - 1);
-    }
+    template <Piece_t p, bool is_white> constexpr static uint8_t piece_key() { return zobrist::piece_key<p, is_white>(); }
     void hash_ep(uint64_t &hash, const Board &board);
-    void hash_castle(uint64_t &hash, const Board &board) { hash ^= castle_numbers[board.get_castling()]; }
+    void hash_castle(uint64_t &hash, const Board &board) { hash ^= zobrist::castle(board.get_castling()); }
     void hash_turn(uint64_t &hash, const Board &board) {
         if (board.get_turn_color() == pieces::black) {
             hash ^= black_number;
@@ -143,74 +185,71 @@ class ZobroistHasher {
 
     uint64_t rand_uint64_t();
     /**
-     * @brief Generate hash from a board
+     * @brief Generate hash from a board from scratch. The board keeps its own hash up to date
+     * (Board::get_hash), so this is only needed to verify it.
      *
      * @param[in] board Board to hash
      * @return hash of board.
      */
     uint64_t hash_board(const Board &board);
     /**
-     * @brief Hash can be incremented by XORing the parts that changed. This is color and pieces
-     * moved and castle information.
-     *
-     * @tparam forward true if move is forwards in time, false if backwards (undo).
-     * @param[in] hash hash updated with the move.
+     * @brief Generate pawn hash from a board from scratch, to verify Board::get_pawn_hash.
      */
-    template <bool forward> void update_hash(uint64_t &hash, const Move move) {}
+    uint64_t hash_pawns(const Board &board);
 };
-struct transposition_table {
-    static constexpr size_t entry_size = sizeof(transposition_entry);
-    static constexpr int size_MB = 16;
-    static constexpr int nbits = [] constexpr {
-        constexpr size_t num_entries = size_MB * 1000000 / entry_size;
-        int msb = 0;
-        int val = num_entries;
-        while (val >>= 1)
-            msb++;
+class transposition_table {
+ public:
+    static constexpr size_t entry_size = sizeof(transposition_slot);
 
-        int numbits;
-        if (num_entries & ~(1ULL << msb)) {  // if other bits were set high too.
-            numbits = msb + 1;
-        } else {
-            numbits = msb;
-        }
+    /**
+     * @brief Allocates a table of at most size_MB megabytes. The number of buckets is rounded down
+     * to a power of two.
+     *
+     * @param[in] size_MB size of table in MB (2^20 bytes).
+     */
+    explicit transposition_table(size_t size_MB = DEFAULT_HASH_MB) { resize(size_MB); }
 
-        return numbits;
-    }();
-    static constexpr int table_size = 1ULL << nbits;
-    static constexpr uint64_t mask = (1ULL << nbits) - 1;  // lowest nbits set high.
-    static constexpr int actual_size_kB = (table_size * entry_size) / 1000;
-    std::array<transposition_entry, table_size> arr;  // array holding the data.
-    size_t hits = 0;                                  // how many times did we access the table and find the board inside?
-    size_t misses = 0;                                // how many times did we access the table and not find the board?
-    size_t collisions = 0;                            // how many times did we have a hash collision?
-    size_t overwrites = 0;
-    size_t writes = 0;
+    /**
+     * @brief Reallocates the table. All entries are lost. Must not be called during a search.
+     *
+     * @param[in] size_MB size of table in MB (2^20 bytes).
+     */
+    void resize(size_t size_MB);
+    size_t get_size_MB() const { return (num_buckets * sizeof(transposition_bucket)) >> 20; }
+    /**
+     * @brief True if the kernel accepted the request to back the table with huge pages.
+     */
+    bool uses_huge_pages() const { return huge_pages; }
+    size_t get_num_buckets() const { return num_buckets; }
 
     /**
-     * @brief Gets key to access the table with
+     * @brief Gets bucket index to access the table with
      *
      * @param[in] hash hash of board
-     * @return key to access array with.
+     * @return index of bucket in table.
      */
-    static inline constexpr size_t get_key(uint64_t hash) { return hash & mask; }
+    inline size_t get_key(uint64_t hash) const { return hash & mask; }
     /**
      * @brief Gets entry from table. If hash matches, return entry.
      *
      * @param[in] hash hash of board.
      */
-    std::optional<transposition_entry> get(uint64_t hash);
+    std::optional<transposition_entry> get(uint64_t hash) const;
 
-    inline void store(uint64_t hash, Move bestmove, int eval, uint8_t nodetype, uint8_t depth) {
-        assert(bestmove.source != bestmove.target);
-        uint64_t shifted_hash = (hash >> transposition_entry::shift_hash);
-        size_t key = get_key(hash);
-        writes++;
-        if (arr[key].nodetype != transposition_entry::invalid) {
-            overwrites++;
-        }
-        arr[key] = {shifted_hash, nodetype, depth, eval, bestmove};
-    }
+    /**
+     * @brief Prefetches the bucket of a position into cache. Call as soon as the hash is known so
+     * the memory access overlaps with other work before get.
+     *
+     * @param[in] hash hash of board.
+     */
+    inline void prefetch(uint64_t hash) const { __builtin_prefetch(&arr[get_key(hash)]); }
+
+    /**
+     * @brief Stores an entry. Replaces, in order of preference: the slot already holding this
+     * position, an empty slot, or the slot with the least depth, where entries from earlier
+     * searches count as shallower.
+     */
+    void store(uint64_t hash, Move bestmove, int eval, uint8_t nodetype, uint8_t depth);
     /**
      * @brief Gets if the entry provided is
      *
@@ -219,15 +258,17 @@ struct transposition_table {
      * @return True if the current depth is smaller than or equal the entries depth.
      */
     static bool is_useable_entry(const transposition_entry entry, const int depth) { return depth <= entry.depth; }
-    void clear() {
-        std::fill(arr.begin(), arr.end(), transposition_entry{0, transposition_entry::invalid, 0, 0, Move()});
-        writes = 0;
-        overwrites = 0;
-    }
+    void clear();
+
+    /**
+     * @brief Starts a new search generation. Entries from older generations are replaced first.
+     *
+     */
+    void new_search() { age = (age + 1) & transposition_entry::age_mask; }
 
     /**
-     * @brief Gets the load factor of the hash table in permille. This is the ratio of filled slots.
-     * entries.
+     * @brief Gets the load factor of the hash table in permille. This is the ratio of filled slots
+     * written by the current search, sampled from the first 1000 buckets.
      *
      * @return [Load factor of table in permille]
      */
@@ -237,7 +278,7 @@ struct transposition_table {
         std::vector<Move> pv_line;
         std::stack<restore_move_info> restore_stack;
         for (int i = 0; i <= depth; i++) {
-            uint64_t hash = ZobroistHasher::get().hash_board(board);
+            uint64_t hash = board.get_hash();
             std::optional<transposition_entry> entry = get(hash);
             if (entry) {
                 if (entry.value().is_valid_move()) {
@@ -263,5 +304,18 @@ struct transposition_table {
         }
         return pv_line;
     }
+
+ private:
+    std::unique_ptr<transposition_bucket[], aligned_bucket_deleter> arr;  // array holding the data. Shared between search threads.
+    size_t num_buckets = 0;
+    bool huge_pages = false;
+    /**
+     * @brief Allocates num_buckets buckets. Tables of at least 2 MB are aligned to 2 MB and
+     * advised to use transparent huge pages, which cuts TLB misses on probes. Falls back to
+     * cache line aligned memory.
+     */
+    void allocate();
+    uint64_t mask = 0;  // num_buckets - 1
+    uint8_t age = 0;
 };
 #endif
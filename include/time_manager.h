@@ -3,17 +3,33 @@
 #define TIME_MANAGER_H
 #include <atomic>
 #include <chrono>
+#include <cstdint>
+#include <optional>
 #include <thread>
 using namespace std::chrono;
 struct time_control {
     int wtime, btime, winc, binc;
 };
+/**
+ * @brief Limits of a search, as given by the UCI go command. 0 means no limit.
+ */
+struct search_limits {
+    std::optional<time_control> clock = {};  // Remaining time and increments. Without a clock or movetime the search has no time limit.
+    int movetime = 0;                        // Time for this move in ms. Used up fully, unlike the clock.
+    int depth = 0;                           // Deepest iteration.
+    uint64_t nodes = 0;                      // Nodes searched by all threads.
+    int mate = 0;                            // Search for a mate in this many moves.
+    bool infinite = false;                   // Search until stop.
+    bool ponder = false;                     // Search on the opponent's time. The clock only starts at ponderhit.
+};
 class TimeManager {
  private:
     std::atomic<bool> should_stop;                  // Shared variable between threads.
     std::atomic<bool> should_start_next_iteration;  // Shared variable between threads.
+    std::atomic<bool> pondering;                    // Time is not counted until ponderhit.
+    std::atomic<int64_t> budget_start;              // Elapsed ms when the time for this move started counting.
     std::thread timer_thread;
-    int remtime, inc, enemy_remtime, enemy_inc, buffer, remtime_frac;
+    int remtime, inc, enemy_remtime, enemy_inc, buffer, remtime_frac, movetime;
     bool infinite;
     time_point<high_resolution_clock> start;
     int calculate_time_elapsed_ms() const;
@@ -54,6 +70,12 @@ class TimeManager {
 
     void start_time_management();
 
+    /**
+     * @brief The opponent played the move that was pondered on. Starts counting the time for this
+     * move from now.
+     */
+    void ponderhit();
+
     /**
      * @brief Called by e.g. calculation thread once it breaks from searching enough depth.
      *
@@ -61,6 +83,11 @@ class TimeManager {
     void stop_and_join();
 
     TimeManager(time_control rem_time, int buffer, int remtime_frac, bool is_white);
+    /**
+     * @brief Time manager of a search with limits from the go command. Only the time limits are
+     * handled here, the search itself stops at its depth and node limits.
+     */
+    TimeManager(const search_limits &limits, int buffer, int remtime_frac, bool is_white);
 
     ~TimeManager();
 };
@@ -3,7 +3,10 @@
 #define UCI_INTERFACE_H
 #include <game.h>
 
+#include <atomic>
+#include <mutex>
 #include <string>
+#include <thread>
 #include <vector>
 class UCIInterface {
  public:
@@ -14,8 +17,28 @@ class UCIInterface {
     static void process_new_game_command();
     static void send_bestmove();
     static void process_d_command();
-    static void process_ponder_command();
+    /**
+     * @brief Stops the search. Its bestmove is sent by the search thread.
+     */
+    static void process_stop_command();
+    /**
+     * @brief The opponent played the pondered move: the search continues on the clock.
+     */
+    static void process_ponderhit_command();
+    /**
+     * @brief Waits for the search thread to send its bestmove. Searches that only end on stop
+     * (infinite, ponder) are stopped first. Called before commands that use the game state.
+     */
+    static void wait_for_search();
     static void process_self_command(std::string command);
+    /**
+     * @brief Sets an engine option. Structure is "name <id> value <x>". Supported options:
+     * Threads - number of search threads. Hash - size of transposition table in MB.
+     * UseNNUE - evaluate with the network if one is loaded. EvalFile - network file to load.
+     *
+     * @param[in] command command body after "setoption"
+     */
+    static void process_setoption_command(std::string command);
 
     /**
      * @brief Checks if game has info to send, if so: send info. Empties game queue.
@@ -30,9 +53,13 @@ class UCIInterface {
     static void send_info_msg(InfoMsg msg);
     /**
      * @brief The go command has the following functionality:
-     * "go perft <depth>": gets number of nodes at a certain depth.
+     * "go perft <depth> [print_depth] [threads <n>] [hash <MB>]": gets number of nodes at a certain
+     * depth. With threads or hash the multithreaded perft is used, which only prints root branches.
      * "go eval": Evaluates current board state with eval function.
-     * "go": Gets bestmove and plays it.
+     * "go [wtime <ms>] [btime <ms>] [winc <ms>] [binc <ms>] [movetime <ms>] [depth <n>] [nodes <n>]
+     * [mate <n>] [infinite] [ponder]": Searches on a new thread and returns. The search thread
+     * streams info and sends bestmove when done. Without clock or movetime the search has no time
+     * limit, a bare "go" searches on the default clock.
      *
      * @param[[TODO:direction]] command [TODO:description]
      */
@@ -44,9 +71,21 @@ class UCIInterface {
      * @param[in] command: String with three parts: <fentype> <depth> <threads>
      * Where fentype is one of: current, default or a literal fen string
      * depth is number of ply moves to search
-     * threads (unused) is number of threads to search with.
+     * threads is number of threads to search with.
      */
     static void process_bench_command(std::string command);
+    /**
+     * @brief Benchmarks the search. Searches a position to a fixed depth with the current Threads
+     * and Hash options and reports nodes per second.
+     * @param[in] parts: <fentype> <depth>, fentype as in process_bench_command.
+     */
+    static void process_bench_search_command(std::vector<std::string> parts);
+    /**
+     * @brief Microbenchmark of move ordering. Times MoveOrder::partial_move_sort on the move
+     * lists of all nodes of a position's tree.
+     * @param[in] parts: <fentype> <depth>, fentype as in process_bench_command.
+     */
+    static void process_bench_sort_command(std::vector<std::string> parts);
 
  private:
     UCIInterface() = delete;
@@ -72,5 +111,22 @@ class UCIInterface {
      */
     static std::string join(std::vector<std::string> strings, char del);
     static std::optional<int> try_process_int(std::string intstring);
+    /**
+     * @brief Sets position of a bench command.
+     *
+     * @param[in] parts <fentype> <depth>
+     * @return depth, if the command was valid.
+     */
+    static std::optional<int> set_bench_position(std::vector<std::string> parts);
+    /**
+     * @brief Body of the search thread: searches, prints info as it arrives on a printing thread,
+     * then sends bestmove.
+     */
+    static void run_search(search_limits limits);
+
+    inline static std::thread search_thread;
+    inline static search_limits current_limits;             // Of the latest search. ponder is cleared on ponderhit.
+    inline static std::atomic<bool> hold_bestmove = false;  // Set during infinite and ponder searches until stop or ponderhit.
+    inline static std::mutex output_mutex;                  // Lines from the input, search and printing threads do not interleave.
 };
 #endif
@@ -0,0 +1,59 @@
+// Copyright 2025 Filip Agert
+#ifndef ZOBRIST_H
+#define ZOBRIST_H
+#include <array>
+#include <cstdint>
+#include <piece.h>
+
+/**
+ * @brief Zobrist keys. Generated at compile time so that the board can update its hash
+ * incrementally without going through the ZobroistHasher singleton.
+ */
+namespace zobrist {
+/**
+ * @brief Splitmix64 step. Used as a constexpr pseudo random number generator.
+ *
+ * @param[inout] state state of generator
+ * @return next pseudo random number
+ */
+constexpr uint64_t splitmix64(uint64_t &state) {
+    uint64_t z = (state += 0x9E3779B97F4A7C15ULL);
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+    return z ^ (z >> 31);
+}
+constexpr uint64_t seed = 0x46696C6970426F74ULL;
+
+struct keys {
+    std::array<std::array<uint64_t, 64>, 12> piece_numbers;  // one number for each piece and square
+    std::array<uint64_t, 16> castle_numbers;                 // one for each castle combination
+    std::array<uint64_t, 8> ep_numbers;                      // file of ep
+    uint64_t black_number;                                   // indicate if black is playing or not.
+};
+alignas(64) constexpr keys table = [] {
+    keys k;
+    uint64_t state = seed;
+    for (int p = 0; p < 12; p++)
+        for (int sq = 0; sq < 64; sq++)
+            k.piece_numbers[p][sq] = splitmix64(state);
+    for (int i = 0; i < 16; i++)
+        k.castle_numbers[i] = splitmix64(state);
+    for (int i = 0; i < 8; i++)
+        k.ep_numbers[i] = splitmix64(state);
+    k.black_number = splitmix64(state);
+    return k;
+}();
+
+/**
+ * @brief Index into piece_numbers for a piece type and color.
+ */
+template <Piece_t p, bool is_white> constexpr uint8_t piece_key() {
+    constexpr uint8_t col_offset = is_white ? 0 : 6;
+    return col_offset + (p - 1);
+}
+template <Piece_t p, bool is_white> constexpr uint64_t piece(uint8_t sq) { return table.piece_numbers[piece_key<p, is_white>()][sq]; }
+constexpr uint64_t castle(uint8_t castleinfo) { return table.castle_numbers[castleinfo & 0b1111]; }
+constexpr uint64_t ep(uint8_t ep_square) { return table.ep_numbers[ep_square & 0b111]; }
+constexpr uint64_t black() { return table.black_number; }
+}  // namespace zobrist
+#endif
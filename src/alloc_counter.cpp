@@ -0,0 +1,37 @@
+// Copyright 2025 Filip Agert
+#include <alloc_counter.h>
+#include <cstdlib>
+#include <new>
+
+namespace {
+thread_local uint64_t allocations = 0;
+
+void *allocate(std::size_t size) {
+    allocations++;
+    if (void *p = std::malloc(size == 0 ? 1 : size))
+        return p;
+    throw std::bad_alloc();
+}
+void *allocate_aligned(std::size_t size, std::align_val_t align) {
+    allocations++;
+    std::size_t alignment = static_cast<std::size_t>(align);
+    if (void *p = std::aligned_alloc(alignment, (size + alignment - 1) / alignment * alignment))  // aligned_alloc needs a multiple of the alignment.
+        return p;
+    throw std::bad_alloc();
+}
+}  // namespace
+
+uint64_t alloc_counter::thread_allocations() { return allocations; }
+
+void *operator new(std::size_t size) { return allocate(size); }
+void *operator new[](std::size_t size) { return allocate(size); }
+void *operator new(std::size_t size, std::align_val_t align) { return allocate_aligned(size, align); }
+void *operator new[](std::size_t size, std::align_val_t align) { return allocate_aligned(size, align); }
+void operator delete(void *p) noexcept { std::free(p); }
+void operator delete[](void *p) noexcept { std::free(p); }
+void operator delete(void *p, std::size_t) noexcept { std::free(p); }
+void operator delete[](void *p, std::size_t) noexcept { std::free(p); }
+void operator delete(void *p, std::align_val_t) noexcept { std::free(p); }
+void operator delete[](void *p, std::align_val_t) noexcept { std::free(p); }
+void operator delete(void *p, std::size_t, std::align_val_t) noexcept { std::free(p); }
+void operator delete[](void *p, std::size_t, std::align_val_t) noexcept { std::free(p); }
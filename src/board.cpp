@@ -1,6 +1,7 @@
 // Copyright 2025 Filip Agert
 #include <board.h>
 #include <cassert>
+#include <eval.h>
 #include <exceptions.h>
 #include <iostream>
 #include <movegen.h>
@@ -150,10 +151,76 @@ bool Board::board_BB_match() {
 
     return true;
 }
-bool Board::is_square_empty(uint8_t square) const { return this->get_piece_at(square) == none_piece; }
-
-uint8_t Board::get_square_color(uint8_t square) const { return this->get_piece_at(square).get_color(); }
+bool Board::see(Move move, int threshold) const {
+    if (move.flag == moveflag::MOVEFLAG_short_castling || move.flag == moveflag::MOVEFLAG_long_castling)
+        return threshold <= 0;
+    const std::array<int, 7> &value = PieceValue::piecevals;
+    const uint8_t to = move.target;
+    BB occ = occupancy() ^ BitBoard::one_high(move.source);
+    int captured = value[get_piece_at(to).get_type()];
+    int moved = value[get_piece_at(move.source).get_type()];
+    if (move.flag == moveflag::MOVEFLAG_pawn_ep_capture) {
+        captured = value[pawn];
+        occ ^= BitBoard::one_high((move.source & ~7) | (to & 7));  // Captured pawn is beside the source.
+    } else if (move.is_promotion()) {
+        captured += value[move.get_promotion()] - value[pawn];
+        moved = value[move.get_promotion()];
+    }
 
+    // swap is what the side to move gains above threshold if the exchange stops here. Each side
+    // in turn captures if it keeps swap non-negative for them, res is 1 if the mover is ahead.
+    int swap = captured - threshold;
+    if (swap < 0)
+        return false;
+    swap = moved - swap;
+    if (swap <= 0)
+        return true;
+
+    const BB diagonal = white_bishops | black_bishops | white_queen | black_queen;
+    const BB straight = white_rooks | black_rooks | white_queen | black_queen;
+    bool stm_white = get_piece_at(move.source).get_color() == white;
+    BB attackers = attackers_to(to, occ);
+    int res = 1;
+    while (true) {
+        stm_white = !stm_white;
+        attackers &= occ;
+        BB stm_attackers = attackers & (stm_white ? white_pieces : black_pieces);
+        if (stm_attackers == 0)
+            break;
+        res ^= 1;
+        // Capture with least valuable attacker. Removing it from occ uncovers sliders behind it.
+        BB bb;
+        if ((bb = stm_attackers & (white_pawns | black_pawns))) {
+            if ((swap = value[pawn] - swap) < res)
+                break;
+            occ ^= BitBoard::one_high(BitBoard::lsb(bb));
+            attackers |= movegen::bishop_atk(to, occ) & diagonal;
+        } else if ((bb = stm_attackers & (white_knights | black_knights))) {
+            if ((swap = value[knight] - swap) < res)
+                break;
+            occ ^= BitBoard::one_high(BitBoard::lsb(bb));
+        } else if ((bb = stm_attackers & (white_bishops | black_bishops))) {
+            if ((swap = value[bishop] - swap) < res)
+                break;
+            occ ^= BitBoard::one_high(BitBoard::lsb(bb));
+            attackers |= movegen::bishop_atk(to, occ) & diagonal;
+        } else if ((bb = stm_attackers & (white_rooks | black_rooks))) {
+            if ((swap = value[rook] - swap) < res)
+                break;
+            occ ^= BitBoard::one_high(BitBoard::lsb(bb));
+            attackers |= movegen::rook_atk(to, occ) & straight;
+        } else if ((bb = stm_attackers & (white_queen | black_queen))) {
+            if ((swap = value[queen] - swap) < res)
+                break;
+            occ ^= BitBoard::one_high(BitBoard::lsb(bb));
+            attackers |= (movegen::bishop_atk(to, occ) & diagonal) | (movegen::rook_atk(to, occ) & straight);
+        } else {
+            // King can only capture if the square is no longer defended.
+            return (attackers & ~(stm_white ? white_pieces : black_pieces)) ? res ^ 1 : res;
+        }
+    }
+    return res;
+}
 void Board::clear_board() {
     for (size_t i = 0; i < 64; i++) {
         this->game_board[i] = Piece();
@@ -172,6 +239,42 @@ void Board::clear_board() {
     black_knights = 0;
     black_rooks = 0;
     black_pawns = 0;
+    hash = 0;
+    pawn_hash = 0;
+    mg_score = 0;
+    eg_score = 0;
+    phase = 0;
+#ifdef USE_NNUE
+    if (nnue::enabled)
+        acc.reset();
+#endif
+}
+
+#ifdef USE_NNUE
+template <Piece_t type, bool is_white> static void add_columns(nnue::accumulator &acc, BB piece_bb) {
+    BitLoop(piece_bb) {
+        acc.add<type, is_white>(BitBoard::lsb(piece_bb));
+    }
+}
+#endif
+void Board::refresh_accumulator() {
+#ifdef USE_NNUE
+    if (!nnue::enabled)
+        return;
+    acc.reset();
+    add_columns<king, true>(acc, white_king);
+    add_columns<queen, true>(acc, white_queen);
+    add_columns<rook, true>(acc, white_rooks);
+    add_columns<bishop, true>(acc, white_bishops);
+    add_columns<knight, true>(acc, white_knights);
+    add_columns<pawn, true>(acc, white_pawns);
+    add_columns<king, false>(acc, black_king);
+    add_columns<queen, false>(acc, black_queen);
+    add_columns<rook, false>(acc, black_rooks);
+    add_columns<bishop, false>(acc, black_bishops);
+    add_columns<knight, false>(acc, black_knights);
+    add_columns<pawn, false>(acc, black_pawns);
+#endif
 }
 
 bool does_move_check(const Move candidate, const uint8_t king_color) {
@@ -364,6 +467,13 @@ bool Board::read_fen(const std::string FEN) {
     // Fullmove number
     full_moves = std::stoi(movePart);
 
+    // Pieces were hashed by add_piece. Hash in the remaining state.
+    hash ^= zobrist::castle(castleinfo);
+    if (en_passant)
+        hash ^= zobrist::ep(en_passant_square);
+    if (turn_color == black)
+        hash ^= zobrist::black();
+
     // ----------------------------
     // 3. Store results in state
     // ----------------------------
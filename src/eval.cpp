@@ -1,32 +1,43 @@
 // Copyright Filip Agert
+#include <algorithm>
 #include <cassert>
 #include <eval.h>
 #include <piece.h>
-int EvalState::eval(Board &board) {
+int EvalState::eval(Board &board, pawn_table *pawns) {
     int score = 0;
     if (forced_draw_ply(board))
         return 0;
+#ifdef USE_NNUE
+    if (nnue::enabled)
+        return nnue::evaluate(board.get_accumulator(), board.get_turn_color() == pieces::white);
+#endif
     // Eval by piece scoring.
-    score += eval_material(board);
-    score += eval_mobility(board);
-    score += eval_king_dist2centre(board);
-    score += eval_pawn_structure(board);
+    score += eval_psqt(board);
+    score += eval_bishop_pair(board);
+    score += eval_pawn_structure(board, pawns);
 
     int color_fac = 1 - 2 * (board.get_turn_color() == pieces::black);
     return score * color_fac;
 }
 
-int EvalState::eval_mobility(Board &board) {
-    constexpr bool omit_pawn = true;
-    int king_mobility = board.get_piece_mobility<pieces::king, omit_pawn, true>() - board.get_piece_mobility<pieces::king, omit_pawn, false>();
-    int bishop_mobility = board.get_piece_mobility<pieces::bishop, omit_pawn, true>() - board.get_piece_mobility<pieces::bishop, omit_pawn, false>();
-    // int queen_mobility = board.get_piece_mobility<pieces::queen, omit_pawn, true>() -
-    //                      board.get_piece_mobility<pieces::queen, omit_pawn, false>();
-    int knight_mobility = board.get_piece_mobility<pieces::knight, omit_pawn, true>() - board.get_piece_mobility<pieces::knight, omit_pawn, false>();
-    int mobility_eval = king_mobility * PieceValue::movevals[pieces::king] + bishop_mobility * PieceValue::movevals[pieces::bishop] +
-                        knight_mobility * PieceValue::movevals[pieces::knight];
-    // queen_mobility * PieceValue::movevals[pieces::queen];
-    return mobility_eval;
+int EvalState::cached_eval(Board &board, eval_cache &evals, pawn_table *pawns) {
+    if (forced_draw_ply(board))
+        return 0;  // The hash does not cover the ply clock, keep this out of the cache.
+    uint64_t hash = board.get_hash();
+    eval_entry &entry = evals.slot(hash);
+    evals.probes++;
+    if (entry.key == hash) {
+        evals.hits++;
+        return entry.score;
+    }
+    entry.key = hash;
+    entry.score = eval(board, pawns);
+    return entry.score;
+}
+
+int EvalState::eval_psqt(Board &board) {
+    int phase = std::min(board.get_phase(), PieceValue::max_phase);  // Promotions can take it past the starting position.
+    return (board.get_mg_score() * phase + board.get_eg_score() * (PieceValue::max_phase - phase)) / PieceValue::max_phase;
 }
 bool EvalState::forced_draw_ply(Board &board) {
     if (board.get_ply_moves() >= 100)
@@ -34,45 +45,14 @@ bool EvalState::forced_draw_ply(Board &board) {
     else
         return false;
 }
-int EvalState::eval_material(Board &board) {
-    int score = 0;
-    score += eval_single_piece<pieces::king>(board);
-    score += eval_single_piece<pieces::queen>(board);
-    score += eval_single_piece<pieces::rook>(board);
-    score += eval_single_piece<pieces::bishop>(board);
-    score += eval_single_piece<pieces::knight>(board);
-    score += eval_single_piece<pieces::pawn>(board);
-    return score;
-}
-template <Piece_t p> int EvalState::eval_single_piece(Board &board) {
-    int pvalue = PieceValue::piecevals[p];
-    int wpiece_cnt = board.get_piece_cnt<p, true>();
-    int bpiece_cnt = board.get_piece_cnt<p, false>();
-    int eval = (wpiece_cnt - bpiece_cnt) * pvalue;
-    if (p == pieces::bishop) {
-        if (wpiece_cnt > 1)
-            eval += PieceValue::bishop_double_bonus;
-        if (bpiece_cnt > 1)
-            eval -= PieceValue::bishop_double_bonus;
-    }
+int EvalState::eval_bishop_pair(Board &board) {
+    int eval = 0;
+    if (board.get_piece_cnt<pieces::bishop, true>() > 1)
+        eval += PieceValue::bishop_double_bonus;
+    if (board.get_piece_cnt<pieces::bishop, false>() > 1)
+        eval -= PieceValue::bishop_double_bonus;
     return eval;
 }
-int EvalState::eval_king_dist2centre(Board &board) {
-    uint8_t white_king_sq = BitBoard::lsb(board.get_piece_bb<pieces::king, true>());
-    uint8_t black_king_sq = BitBoard::lsb(board.get_piece_bb<pieces::king, false>());
-    uint8_t white_dist = helpers::dist2centre[white_king_sq];
-    uint8_t black_dist = helpers::dist2centre[black_king_sq];
-    uint8_t king_dist = helpers::manhattan(white_king_sq, black_king_sq);
-    float white_endgame = 2 * eval_game_phase(board.get_num_pieces<false>()) - 1;  // eval based on black pieces
-    float black_endgame = 2 * eval_game_phase(board.get_num_pieces<true>()) - 1;   // eval based on white pieces
-
-    // Absolute king position value.
-    float wval = -white_dist * PieceValue::king_dist2centre_value * white_endgame;
-    float bval = black_dist * PieceValue::king_dist2centre_value * black_endgame;
-
-    float relval = king_dist * (white_endgame - black_endgame) * PieceValue::king_dist2centre_value;
-    return static_cast<int>(wval + bval + relval);
-}
 std::optional<int> EvalState::moves_to_mate(int score) {
     // Negative score should remain negative.
     int dist = abs(abs(score) - MATE_SCORE);
@@ -84,7 +64,29 @@ std::optional<int> EvalState::moves_to_mate(int score) {
     }
 }
 
-int EvalState::eval_pawn_structure(Board &board) {
+int EvalState::eval_pawn_structure(Board &board, pawn_table *pawns) {
+    if (!pawns)
+        return eval_pawns(board).score;
+    pawn_entry &entry = pawns->slot(board.get_pawn_hash());
+    pawns->probes++;
+    if (entry.key == board.get_pawn_hash()) {
+        pawns->hits++;
+    } else {
+        entry = eval_pawns(board);
+    }
+    return entry.score;
+}
+
+/**
+ * @brief One bit per file holding at least one of the pawns.
+ */
+static uint8_t pawn_files(BB pawns) {
+    pawns |= pawns >> 32;
+    pawns |= pawns >> 16;
+    pawns |= pawns >> 8;
+    return static_cast<uint8_t>(pawns);
+}
+pawn_entry EvalState::eval_pawns(const Board &board) {
     constexpr int maxforward = 4;
     constexpr BB AFILE = ~masks::left;
     constexpr BB HFILE = ~masks::right;
@@ -140,6 +142,13 @@ int EvalState::eval_pawn_structure(Board &board) {
     int nsolow = BitBoard::bitcount(wpawns) - BitBoard::bitcount(w_sides & wpawns);
     int nsolob = BitBoard::bitcount(bpawns) - BitBoard::bitcount(b_sides & bpawns);
 
-    return (wpassed - bpassed) * PieceValue::passed_pawn_eval + (wdoubled - bdoubled) * PieceValue::doubled_pawn_punishment +
-           (nsolow - nsolob) * PieceValue::solo_pawn_punishment;
+    pawn_entry entry;
+    entry.key = board.get_pawn_hash();
+    entry.score = (wpassed - bpassed) * PieceValue::passed_pawn_eval + (wdoubled - bdoubled) * PieceValue::doubled_pawn_punishment +
+                  (nsolow - nsolob) * PieceValue::solo_pawn_punishment;
+    entry.passed[true] = ~b_full_mask & wpawns;
+    entry.passed[false] = ~w_full_mask & bpawns;
+    entry.semi_open_files[true] = ~pawn_files(wpawns);
+    entry.semi_open_files[false] = ~pawn_files(bpawns);
+    return entry;
 }
@@ -1,7 +1,9 @@
 // Copyright 2025 Filip Agert
 #include <algorithm>
+#include <alloc_counter.h>
 #include <array>
 #include <moveorder.h>
+#include <movepicker.h>
 
 #include <board.h>
 #include <chrono>
@@ -9,12 +11,37 @@
 #include <config.h>
 #include <eval.h>
 #include <game.h>
-#include <iostream>
 #include <memory>
 #include <move.h>
 #include <string>
 #include <time_manager.h>
 #include <utility>
+namespace lmr {
+/**
+ * @brief Natural logarithm usable in constant expressions: ln(x) = 2 atanh((x - 1) / (x + 1)).
+ */
+constexpr double log(double x) {
+    double y = (x - 1) / (x + 1);
+    double term = y;
+    double sum = 0;
+    for (int k = 1; k < 200; k += 2) {
+        sum += term / k;
+        term *= y * y;
+    }
+    return 2 * sum;
+}
+constexpr int size = 64;
+/**
+ * @brief Base late move reduction indexed [depth][move number]. Grows with the log of both.
+ */
+constexpr std::array<std::array<int, size>, size> reductions = [] {
+    std::array<std::array<int, size>, size> table = {};
+    for (int depth = 1; depth < size; depth++)
+        for (int movenum = 1; movenum < size; movenum++)
+            table[depth][movenum] = static_cast<int>(0.75 + log(depth) * log(movenum) / 2.25);
+    return table;
+}();
+}  // namespace lmr
 bool Game::set_fen(std::string FEN) {
     bool success = board.read_fen(FEN);
     assert(board.board_BB_match());
@@ -22,48 +49,136 @@ bool Game::set_fen(std::string FEN) {
     trans_table->clear();
     return success;
 }
-void Game::start_thinking(const time_control rem_time) {
+void Game::start_thinking(const search_limits &limits) {
     reset_infos();
+    board.refresh_accumulator();  // The network may have been enabled after the position was set.
+    trans_table->new_search();
+    node_limit = limits.nodes;
     bool is_white = board.get_turn_color() == pieces::white;
     if (is_white)
-        think_loop<true>(rem_time);
+        think_loop<true>(limits);
     else
-        think_loop<false>(rem_time);
+        think_loop<false>(limits);
+}
+void Game::stop() {
+    std::lock_guard<std::mutex> lock(signal_mutex);
+    stop_signal = true;
+    if (time_manager)
+        time_manager->set_should_stop(true);
+}
+void Game::ponderhit() {
+    std::lock_guard<std::mutex> lock(signal_mutex);
+    ponderhit_signal = true;
+    if (time_manager)
+        time_manager->ponderhit();
+}
+void Game::reset_signals() {
+    std::lock_guard<std::mutex> lock(signal_mutex);
+    stop_signal = false;
+    ponderhit_signal = false;
 }
 
 void Game::reset_infos() {
     moves_generated = 0;
     nodes_evaluated = 0;
     bestmove = Move();
+    completed_depth = 0;
+    root_bestmove = Move();
+    for (search_stack_entry &entry : search_stack)
+        entry.killers = {};
+    search_stack[0].hash = board.get_hash();
+    allocations = 0;
+    reverse_futility_prunes = 0;
+    futility_prunes = 0;
+    delta_prunes = 0;
+    pawns.probes = 0;
+    pawns.hits = 0;
+    // Cleared every search, UseNNUE and EvalFile may have changed what the entries mean.
+    evals.clear();
+    evals.probes = 0;
+    evals.hits = 0;
+    // Keep what history learned in the previous search, but let the new one outweigh it.
+    for (auto &from : history)
+        for (auto &to : from)
+            for (int &entry : to)
+                entry /= 2;
+}
+
+void Game::set_threads(int num_threads) {
+    num_threads = std::max(num_threads, 1);
+    helpers.clear();
+    for (int id = 1; id < num_threads; id++)
+        helpers.push_back(std::unique_ptr<Game>(new Game(trans_table, id)));
+}
+
+template <bool is_white> void Game::start_helpers() {
+    for (std::unique_ptr<Game> &helper : helpers) {
+        helper->board = board;
+        helper->state_stack = state_stack;
+        helper->time_manager = time_manager;
+        helper->reset_infos();
+        Game *h = helper.get();
+        helper_threads.emplace_back([h] { h->helper_loop<is_white>(); });
+    }
+}
+
+void Game::stop_helpers() {
+    time_manager->set_should_stop(true);
+    for (std::thread &t : helper_threads)
+        t.join();
+    helper_threads.clear();
+    // Vote: the thread that got deepest has the most reliable move.
+    int best_depth = completed_depth;
+    for (std::unique_ptr<Game> &helper : helpers) {
+        if (helper->completed_depth > best_depth && helper->bestmove.is_valid()) {
+            best_depth = helper->completed_depth;
+            bestmove = helper->bestmove;
+        }
+    }
+}
+
+template <bool is_white> void Game::helper_loop() {
+    for (int depth = 1; depth < MAX_PLY; depth++) {
+        seldepth = 0;
+        int search_depth = std::min(depth + (helper_id & 1), MAX_PLY - 1);  // Odd helpers search one ply ahead to desynchronise from the main thread.
+        uint64_t allocations_before = alloc_counter::thread_allocations();
+        alpha_beta<true, is_white>(search_depth, 0, -INF, INF, 0);
+        allocations += alloc_counter::thread_allocations() - allocations_before;
+        if (time_manager->get_should_stop())
+            break;
+        completed_depth = search_depth;
+        bestmove = root_bestmove;
+    }
+}
+
+uint64_t Game::get_total_nodes() const {
+    uint64_t nodes = nodes_evaluated.load(std::memory_order_relaxed);
+    for (const std::unique_ptr<Game> &helper : helpers)
+        nodes += helper->nodes_evaluated.load(std::memory_order_relaxed);
+    return nodes;
 }
 
 void Game::reset_state_stack() {
     state_stack.reset();
-    uint64_t board_hash = ZobroistHasher::get().hash_board(board);
-    state_stack.push(board_hash);
+    assert(board.get_hash() == ZobroistHasher::get().hash_board(board));
+    state_stack.push(board.get_hash());
 }
 
-template <bool is_white> void Game::think_loop(const time_control rem_time) {
-    if (this->check_repetition()) {
-        InfoMsg new_msg;
-        new_msg.stringmsg = true;
-        new_msg.string = "draw by threefold repetition detected";
+template <bool is_white> void Game::think_loop(const search_limits &limits) {
+    if (this->check_repetition(0)) {
+        push_string("draw by threefold repetition detected");
         return;
     } else if (EvalState::forced_draw_ply(board)) {
-        InfoMsg new_msg;
-        new_msg.stringmsg = true;
-        new_msg.string = "draw by excess ply moves.";
+        push_string("draw by excess ply moves.");
         return;
     } else {
         int num_moves = board.get_moves<normal_search, is_white>(move_arr[0]);
         if (num_moves == 0) {
-            InfoMsg new_msg;
-            new_msg.stringmsg = true;
             if (board.king_checked<is_white>()) {
                 std::string othercol = is_white ? "black" : "white";
-                new_msg.string = "mate detected " + othercol + " has won the game.";
+                push_string("mate detected " + othercol + " has won the game.");
             } else {
-                new_msg.string = "draw detected";
+                push_string("draw detected");
             }
             return;
         }
@@ -71,70 +186,154 @@ template <bool is_white> void Game::think_loop(const time_control rem_time) {
     int buffer = STANDARD_TIME_BUFFER;  // ms
     int fraction = STANDARD_TIME_FRAC;  // spend 1/20th of remaining time.
 
-    time_manager = std::make_shared<TimeManager>(rem_time, buffer, fraction, is_white);
+    {
+        std::lock_guard<std::mutex> lock(signal_mutex);
+        time_manager = std::make_shared<TimeManager>(limits, buffer, fraction, is_white);
+        if (ponderhit_signal)
+            time_manager->ponderhit();
+        if (stop_signal)
+            time_manager->set_should_stop(true);
+    }
 
     time_manager->start_time_management();
-    int max_depth = 256;
-    uint64_t hash = ZobroistHasher::get().hash_board(board);
+    start_helpers<is_white>();
+    uint64_t hash = board.get_hash();
     assert(board.board_BB_match());
-    for (int depth = 1; depth < max_depth; depth++) {
+    uint64_t prev_total_nodes = 0;
+    uint64_t prev_iteration_nodes = 0;
+    std::optional<int> eval = {};  // Score of the previous iteration.
+    InfoMsg last_msg;
+    bool last_msg_queued = true;
+    int depth_limit = limits.depth > 0 ? limits.depth : max_depth;
+    if (limits.mate > 0 && limits.depth == 0)
+        depth_limit = 2 * limits.mate;  // A mate in n moves is found within 2n - 1 plies.
+    for (int depth = 1; depth <= std::min(depth_limit, MAX_PLY - 1); depth++) {
         seldepth = 0;
         if (!time_manager->get_should_start_new_iteration())
             break;
+        // Aspiration window: expect a score close to the previous iteration's. A narrow window
+        // prunes more, if the score falls outside it, widen on that side and search again.
         int alpha = -INF;
-        const int beta = INF;
-        alpha_beta<true, is_white>(depth, 0, alpha, beta, 0);
-        InfoMsg new_msg;
-        new_msg.nodes = this->nodes_evaluated;
-        new_msg.time = time_manager->get_time_elapsed();
-        new_msg.depth = depth;
-        new_msg.pv = trans_table->get_pv<is_white>(board, depth);
-        new_msg.seldepth = seldepth;
-        new_msg.hashfill = trans_table->load_factor();
+        int beta = INF;
+        int delta = ASPIRATION_WINDOW;
+        if (depth >= ASPIRATION_MIN_DEPTH && eval) {
+            alpha = std::max(eval.value() - delta, -INF);
+            beta = std::min(eval.value() + delta, INF);
+        }
+        while (true) {
+            uint64_t allocations_before = alloc_counter::thread_allocations();
+            int score = alpha_beta<true, is_white>(depth, 0, alpha, beta, 0);
+            allocations += alloc_counter::thread_allocations() - allocations_before;
+            if (time_manager->get_should_stop())
+                break;
+            if (score > alpha && score < beta)
+                break;
+            InfoMsg bound_msg = iteration_info<is_white>(depth);
+            bound_msg.score = score;
+            delta *= 2;
+            if (score <= alpha) {
+                bound_msg.upperbound = true;
+                alpha = delta > ASPIRATION_MAX_WINDOW ? -INF : std::max(score - delta, -INF);
+            } else {
+                bound_msg.lowerbound = true;
+                beta = delta > ASPIRATION_MAX_WINDOW ? INF : std::min(score + delta, INF);
+            }
+            info_queue.push(bound_msg);
+        }
+        if (!time_manager->get_should_stop())
+            completed_depth = depth;
+        InfoMsg new_msg = iteration_info<is_white>(depth);
+        uint64_t iteration_nodes = new_msg.nodes - prev_total_nodes;
+        if (prev_iteration_nodes > 0)
+            new_msg.ebf = static_cast<double>(iteration_nodes) / prev_iteration_nodes;
+        prev_total_nodes = new_msg.nodes;
+        prev_iteration_nodes = iteration_nodes;
         if (new_msg.pv.size() > 0) {
             bestmove = new_msg.pv[0];
-            if (bestmove.source == bestmove.target) {
-                std::cout << "Illegal move made." << std::endl;
-            }
+            if (bestmove.source == bestmove.target)
+                push_string("illegal move in the pv");
         }
 
         std::optional<transposition_entry> entry = trans_table->get(hash);
-        std::optional<int> eval = {};
+        eval = {};
         if (entry) {
             new_msg.score = entry.value().eval;
-            info_queue.push(new_msg);
+            last_msg = new_msg;
+            last_msg_queued = info_queue.push(new_msg);
             eval = std::make_optional(new_msg.score);
-        } else {
-            std::cout << "Err: could not get entry for hash. Depth: " << depth << std::endl;
+        } else if (!time_manager->get_should_stop()) {  // Stopping before the root is stored is expected.
+            push_string("no transposition table entry for the root at depth " + std::to_string(depth));
         }
 
         std::optional<int> moves_to_mate = eval ? EvalState::moves_to_mate(eval.value()) : 0;
         if (moves_to_mate) {
             break;
         }
+        if (time_manager->get_should_stop())  // Stopped by time, node limit or the stop command.
+            break;
     }
 
+    if (!last_msg_queued)
+        push_final_info(last_msg);
+    stop_helpers();
+    if (!bestmove.is_valid()) {  // Stopped before the first iteration finished, any legal move beats none.
+        board.get_moves<normal_search, is_white>(move_arr[0]);
+        bestmove = move_arr[0][0];
+    }
     time_manager->stop_and_join();  // Join time manager thread to this one.
 }
 
-template <bool is_root, bool is_white> int Game::alpha_beta(int depth, int ply, int alpha, int beta, int num_extensions) {
+void Game::push_string(const std::string &string) {
+    InfoMsg msg;
+    msg.stringmsg = true;
+    msg.string = string;
+    info_queue.push(msg);
+}
+
+void Game::push_final_info(const InfoMsg &msg) {
+    for (int waited = 0; !info_queue.push(msg) && waited < INFO_FINAL_WAIT_MS; waited += INFO_POLL_MS)
+        std::this_thread::sleep_for(std::chrono::milliseconds(INFO_POLL_MS));
+}
+
+template <bool is_white> InfoMsg Game::iteration_info(int depth) {
+    InfoMsg msg;
+    msg.nodes = get_total_nodes();
+    msg.time = time_manager->get_time_elapsed();
+    msg.depth = depth;
+    msg.pv = trans_table->get_pv<is_white>(board, depth);
+    msg.seldepth = seldepth;
+    msg.hashfill = trans_table->load_factor();
+    msg.reverse_futility_prunes = reverse_futility_prunes;
+    msg.futility_prunes = futility_prunes;
+    msg.delta_prunes = delta_prunes;
+    msg.pawn_hash_hits = pawns.probes ? static_cast<double>(pawns.hits) / pawns.probes : 0;
+    msg.eval_cache_hits = evals.probes ? static_cast<double>(evals.hits) / evals.probes : 0;
+    msg.allocations = allocations;
+    return msg;
+}
+
+template <bool is_root, bool is_white> int Game::alpha_beta(int depth, int ply, int alpha, int beta, int num_extensions, bool allow_null) {
     seldepth = std::max(ply, seldepth);
-    if (this->check_repetition()) {
+    if (this->check_repetition(ply)) {
         return 0;  // Checks if position is a repeat.
     }
     if (EvalState::forced_draw_ply(board)) {
         return 0;
     }
+    if (ply >= MAX_PLY - 1)  // Extensions can make the line longer than the iteration depth.
+        return EvalState::cached_eval(board, evals, &pawns);
 
     if (depth <= 0) {
         nodes_evaluated++;
+        if (node_limit && helper_id == 0 && get_total_nodes() >= node_limit)
+            time_manager->set_should_stop(true);
         return quiesence<is_white>(ply, alpha, beta);
     }
 
-    uint64_t zob_hash = ZobroistHasher::get().hash_board(board);
+    const bool pv_node = beta - alpha > 1;  // Null window searches are not on the principal variation.
+    uint64_t zob_hash = board.get_hash();
     std::optional<transposition_entry> maybe_entry = trans_table->get(zob_hash);
-    std::optional<Move> first_move = {};
-    int movelb = 0;
+    std::optional<Move> tt_move = {};
     Move best_curr_move;
     bool atleast_one_move_searched = false;
     int bestscore = -INF;
@@ -145,6 +344,8 @@ template <bool is_root, bool is_white> int Game::alpha_beta(int depth, int ply,
             // If exact, return score
             int eval = entry.eval;
             if (entry.is_exact()) {  // if exact value
+                if (is_root && entry.is_valid_move())
+                    root_bestmove = entry.bestmove;
                 return eval;
             } else if (entry.is_lb()) {
                 if (eval >= beta)  // if its a lower bound, but this lower bound is BETTER than
@@ -161,74 +362,111 @@ template <bool is_root, bool is_white> int Game::alpha_beta(int depth, int ply,
             }
         }
         // If the transposition table entry was not useable due to bad depth, or if it was not
-        // enough to produce a cutoff, it can still be used for move ordering.
-        first_move = std::make_optional(entry.bestmove);
-        // We first search the first move before generating the other moves. If it generates a
-        // cutoff, we save plenty of time.
-        if (entry.is_valid_move()) {  // need ot check if its a valid move or not, since it might be
-                                      // e.g. no moves available on this state.
-            make_move<is_white>(entry.bestmove);
-            int extension = calculate_extension<!is_white>(entry.bestmove, 0, num_extensions);
-            int eval = -alpha_beta<false, !is_white>(depth - 1, ply + 1, -beta, -alpha, num_extensions + extension);
-            undo_move<is_white>();
-            if (time_manager->get_should_stop()) {
-                return 0;  // should not store into transposition table here since the search was
-                           // cancelled.
-            }
-            bestscore = eval;
-            best_curr_move = entry.bestmove;
-            atleast_one_move_searched = true;
-            if (eval >= beta) {  // FAIL HIGH: move is too good, will never get here.
-                trans_table->store(zob_hash, entry.bestmove, beta, transposition_entry::lb,
-                                   depth);  // Can update hash to curr depth.
-                return beta;
-            }
+        // enough to produce a cutoff, it can still be used for move ordering. The move picker
+        // yields it before generating any moves, if it cuts off we save plenty of time.
+        if (entry.is_valid_move())  // need ot check if its a valid move or not, since it might be
+                                    // e.g. no moves available on this state.
+            tt_move = std::make_optional(entry.bestmove);
+    }
 
-            if (eval > alpha) {  // alpha raised and node is exact.
-                alpha = eval;
-                nodetype = transposition_entry::exact;
-            }
-            movelb = 1;
-        }
+    const bool in_check = board.king_checked<is_white>();
+    const bool can_prune = !is_root && !pv_node && !in_check;
+    const int static_eval = can_prune ? EvalState::cached_eval(board, evals, &pawns) : 0;
+    search_stack[ply].in_check = in_check;
+    search_stack[ply].static_eval = static_eval;
+
+    // Reverse futility pruning: close to the leaves, a static eval this far above beta is not
+    // expected to drop below it.
+    if (can_prune && depth < static_cast<int>(REVERSE_FUTILITY_MARGINS.size()) && static_eval - REVERSE_FUTILITY_MARGINS[depth] >= beta) {
+        reverse_futility_prunes++;
+        return beta;
     }
 
-    // Handle if king is checked or no moves can be made.
-    assert(ply < 64);
-    int num_moves = board.get_moves<normal_search, is_white>(move_arr[ply]);
-    moves_generated += num_moves;
-    if (num_moves == 0) {
-        const int MATE_SCORE = 30000;
-        if (board.king_checked<is_white>()) {
-            return (-MATE_SCORE + ply);
-        } else {
+    // Null move pruning: if passing the turn still fails high on a reduced search, a real move
+    // almost surely does too. Not at PV nodes, in check or with only pawns, where zugzwang makes
+    // passing better than any move.
+    if (can_prune && allow_null && depth >= NULL_MOVE_MIN_DEPTH && static_eval >= beta && board.has_non_pawn_material<is_white>()) {
+        int reduction = 3 + depth / 4 + std::min((static_eval - beta) / 200, 2);
+        make_null_move(ply);
+        int null_eval = -alpha_beta<false, !is_white>(depth - 1 - reduction, ply + 1, -beta, -beta + 1, num_extensions, false);
+        undo_null_move(ply);
+        if (time_manager->get_should_stop())
             return 0;
+        if (null_eval >= beta) {
+            // Deep cutoffs prune large trees, check them with a reduced search without null moves.
+            if (depth < NULL_MOVE_VERIFY_DEPTH || alpha_beta<false, is_white>(depth - reduction, ply, beta - 1, beta, num_extensions, false) >= beta)
+                return beta;
         }
     }
-    // End mate and draws.
 
-    MoveOrder::apply_move_sort<is_white>(move_arr[ply], num_moves, first_move, board);
-    // Normal move generation.
-    //
-    for (uint8_t i = movelb; i < num_moves; i++) {
-        make_move<is_white>(move_arr[ply][i]);
-        int extension = calculate_extension<!is_white>(move_arr[ply][i], i, num_extensions);
+    // Futility pruning: close to the leaves, quiet moves can't bring a static eval this far below
+    // alpha back up to it.
+    const bool futile = can_prune && depth < static_cast<int>(FUTILITY_MARGINS.size()) && static_eval + FUTILITY_MARGINS[depth] <= alpha;
+
+    MovePicker<is_white> picker(board, move_arr[ply], tt_move, search_stack[ply].killers, &history);
+    std::array<Move, max_legal_moves> quiets;  // Quiet moves searched without a cutoff.
+    int num_quiets = 0;
+    Move move;
+    uint8_t movenum = 0;
+    while (picker.next(move)) {
+        moves_generated++;
+        bool quiet = MoveOrder::is_quiet(move, board);
+        bool killer = move == search_stack[ply].killers[0] || move == search_stack[ply].killers[1];
+        make_move<is_white>(move, ply);
+        movenum++;
+        const bool gives_check = board.king_checked<!is_white>();
+        int extension = calculate_extension(gives_check, num_extensions);
+        if (futile && movenum > 1 && quiet && !killer && !gives_check) {
+            undo_move<is_white>(ply);
+            futility_prunes++;
+            continue;
+        }
+        int new_depth = depth - 1 + extension;
+
+        // Late move reductions: quiet moves late in the ordering rarely beat alpha, search them
+        // shallower. Less so on the PV, when escaping check or for moves with good history.
+        int reduction = 0;
+        if (depth >= LMR_MIN_DEPTH && movenum > LMR_MIN_MOVES && quiet && !killer && !gives_check) {
+            reduction = lmr::reductions[std::min(depth, lmr::size - 1)][std::min<int>(movenum, lmr::size - 1)];
+            reduction -= pv_node;
+            reduction -= in_check;
+            reduction -= history[is_white][move.source][move.target] / LMR_HISTORY_DIVISOR;
+            reduction = std::clamp(reduction, 0, new_depth - 1);
+        }
 
-        int eval = -alpha_beta<false, !is_white>(depth - 1 + extension, ply + 1, -beta, -alpha, num_extensions + extension);
-        undo_move<is_white>();
+        // Principal variation search: the first move is expected to be best. Later moves are only
+        // shown to be worse with a null window, and searched again with the full window if not.
+        // A reduced move beating alpha is first searched again at full depth.
+        int eval;
+        if (movenum == 1) {
+            eval = -alpha_beta<false, !is_white>(new_depth, ply + 1, -beta, -alpha, num_extensions + extension);
+        } else {
+            eval = -alpha_beta<false, !is_white>(new_depth - reduction, ply + 1, -alpha - 1, -alpha, num_extensions + extension);
+            if (reduction > 0 && eval > alpha)
+                eval = -alpha_beta<false, !is_white>(new_depth, ply + 1, -alpha - 1, -alpha, num_extensions + extension);
+            if (eval > alpha && eval < beta)
+                eval = -alpha_beta<false, !is_white>(new_depth, ply + 1, -beta, -alpha, num_extensions + extension);
+        }
+        undo_move<is_white>(ply);
         if (time_manager->get_should_stop()) {
             if (is_root) {
                 if (atleast_one_move_searched) {
                     trans_table->store(zob_hash, best_curr_move, bestscore, transposition_entry::lb, depth);
                 }
             }
-            return 0;
+            return 0;  // should not store into transposition table here since the search was
+                       // cancelled.
         }
         if (eval > bestscore) {
             bestscore = eval;
-            best_curr_move = move_arr[ply][i];
+            best_curr_move = move;
+            if (is_root)
+                root_bestmove = best_curr_move;
             atleast_one_move_searched = true;
         }
         if (eval >= beta) {  // FAIL HIGH.
+            if (quiet)
+                update_quiet_stats<is_white>(move, ply, depth, quiets, num_quiets);
             trans_table->store(zob_hash, best_curr_move, beta, transposition_entry::lb,
                                depth);  // Can update hash to curr depth.
             return beta;                // This move is too good. The minimising player (beta) will never
@@ -238,37 +476,85 @@ template <bool is_root, bool is_white> int Game::alpha_beta(int depth, int ply,
             alpha = eval;    // if alpha is never raised, the value returned will be an upper bound.
             nodetype = transposition_entry::exact;
         }
+        if (quiet)
+            quiets[num_quiets++] = move;
+    }
+    // Handle if king is checked or no moves can be made.
+    if (movenum == 0) {
+        if (in_check) {
+            return (-EvalState::MATE_SCORE + ply);
+        } else {
+            return 0;
+        }
     }
     trans_table->store(zob_hash, best_curr_move, alpha, nodetype, depth);
     return alpha;
 }
 
-template <bool is_white> int Game::quiesence(int ply, int alpha, int beta) {
-    if (this->check_repetition())
+template <bool is_white> int Game::quiesence(int ply, int alpha, int beta, int qply) {
+    if (this->check_repetition(ply))
         return 0;  // Checks if position is a repeat.
     if (EvalState::forced_draw_ply(board))
         return 0;
-
-    int eval = EvalState::eval(board);
     seldepth = std::max(ply, seldepth);
+    if (ply >= static_cast<int>(move_arr.size()) - 1)  // Evasions and checks can make the line longer than the captures alone.
+        return EvalState::cached_eval(board, evals, &pawns);
 
-    // This assumes that there is at least one move that can match, or increase the current score.
-    // So best_value is a lower bound.
-    if (eval >= beta)
-        return beta;
-    alpha = std::max(alpha, eval);
+    int eval;
+    int num_moves;
+    if (board.king_checked<is_white>()) {
+        // No stand pat when in check, standing still is not an option. Search all evasions so mates
+        // at the horizon are seen.
+        num_moves = board.get_moves<normal_search, is_white>(move_arr[ply]);
+        moves_generated += num_moves;
+        if (num_moves == 0)
+            return -EvalState::MATE_SCORE + ply;
+        MoveOrder::apply_move_sort<is_white>(move_arr[ply], num_moves, board);
+    } else {
+        const int stand_pat = EvalState::cached_eval(board, evals, &pawns);
 
-    // Handle if king is checked or no moves can be made.
-    assert(ply < 64);
-    int num_moves = board.get_moves<quiesence_search, is_white>(move_arr[ply]);
-    moves_generated += num_moves;
+        // This assumes that there is at least one move that can match, or increase the current score.
+        // So best_value is a lower bound.
+        if (stand_pat >= beta)
+            return beta;
+        alpha = std::max(alpha, stand_pat);
+
+        num_moves = board.get_moves<quiesence_search, is_white>(move_arr[ply]);
+        moves_generated += num_moves;
+        // Drop captures that lose material by static exchange, they rarely raise alpha above the stand
+        // pat score but make up most of the tree on tactical positions. Delta pruning: also drop
+        // captures that can't reach alpha even if the captured material comes for free.
+        int num_good = 0;
+        for (int i = 0; i < num_moves; i++) {
+            Move move = move_arr[ply][i];
+            int gain = move.flag == moveflag::MOVEFLAG_pawn_ep_capture ? PieceValue::pawn : PieceValue::piecevals[board.get_piece_at(move.target).get_type()];
+            if (move.is_promotion())
+                gain += PieceValue::piecevals[move.get_promotion()] - PieceValue::pawn;
+            if (stand_pat + gain + DELTA_MARGIN <= alpha) {
+                delta_prunes++;
+                continue;
+            }
+            if (board.see(move, 0))
+                move_arr[ply][num_good++] = move;
+        }
+        num_moves = num_good;
+        MoveOrder::apply_move_sort<is_white>(move_arr[ply], num_moves, board);
+
+        // Quiet checks after the captures, in the first plies only. The reply is searched as an evasion.
+        if (qply < QSEARCH_CHECK_PLIES) {
+            int num_checks = board.get_moves<quiet_check_search, is_white>(move_arr[ply].data() + num_moves);
+            moves_generated += num_checks;
+            for (int i = num_moves; i < num_moves + num_checks; i++)
+                if (board.see(move_arr[ply][i], 0))
+                    move_arr[ply][num_good++] = move_arr[ply][i];
+            num_moves = num_good;
+        }
+    }
 
-    MoveOrder::apply_move_sort<is_white>(move_arr[ply], num_moves, board);
-    // Normal move generation.
     for (int i = 0; i < num_moves; i++) {
-        make_move<is_white>(move_arr[ply][i]);
-        eval = -quiesence<!is_white>(ply + 1, -beta, -alpha);
-        undo_move<is_white>();
+        make_move<is_white>(move_arr[ply][i], ply);
+        eval = -quiesence<!is_white>(ply + 1, -beta, -alpha, qply + 1);
+        undo_move<is_white>(ply);
         if (time_manager->get_should_stop()) {
             return 0;
         }
@@ -280,43 +566,82 @@ template <bool is_white> int Game::quiesence(int ply, int alpha, int beta) {
     return alpha;
 }
 
-template <bool is_white> int Game::calculate_extension(const Move move, uint8_t movenum, int num_extensions) const {
+int Game::calculate_extension(bool gives_check, int num_extensions) const {
     constexpr int max_num_extensions = 16;
 
     int extension = 0;
     if (num_extensions < max_num_extensions) {
-        if (board.king_checked<is_white>())
+        if (gives_check)
             extension = 1;
     }
-    if (movenum > 3)
-        extension -= 1;
     return extension;
 }
 
-bool Game::check_repetition() {
+template <bool is_white> void Game::update_quiet_stats(Move move, int ply, int depth, const std::array<Move, max_legal_moves> &quiets, int num_quiets) {
+    std::array<Move, 2> &killers = search_stack[ply].killers;
+    if (!(move == killers[0])) {
+        killers[1] = killers[0];
+        killers[0] = move;
+    }
+    int bonus = std::min(16 * depth * depth, MoveOrder::max_history / 4);
+    MoveOrder::update_history(history[is_white][move.source][move.target], bonus);
+    for (int i = 0; i < num_quiets; i++)
+        MoveOrder::update_history(history[is_white][quiets[i].source][quiets[i].target], -bonus);
+}
+
+bool Game::check_repetition(int ply) {
     // Checks if we have repeated this board state.
-    uint64_t hash = state_stack.top();
+    uint64_t hash = board.get_hash();
     constexpr int instances_for_draw = 3;  // How many occurences of this board should have occured for a draw?
-    bool atleast2 = state_stack.atleast_num(hash, instances_for_draw);
-    return atleast2;
+    int count = 0;
+    for (int i = ply; i > 0 && count < instances_for_draw; i--)  // The root, ply 0, is the top of the state stack.
+        count += search_stack[i].hash == hash;
+    return count == instances_for_draw || state_stack.atleast_num(hash, instances_for_draw - count);
 }
 Move Game::get_bestmove() const { return bestmove; }
 
 std::string Game::get_fen() const { return board.fen_from_state(); }
 
-template <bool is_white> void Game::make_move(Move move) {
-    restore_move_info info = board.do_move<is_white>(move);
-    move_stack.push(move);
-    restore_info_stack.push(info);
-    uint64_t state_hash = ZobroistHasher::get().hash_board(board);
-    state_stack.push(state_hash);
+template <bool is_white> void Game::make_move(Move move, int ply) {
+    search_stack_entry &entry = search_stack[ply];
+    entry.move = move;
+#ifdef COPY_MAKE
+    entry.snapshot = board.snapshot();
+#ifdef USE_NNUE
+    if (nnue::enabled)
+        entry.acc = board.get_accumulator();
+#endif
+    board.do_move<is_white>(move);
+#else
+    entry.restore = board.do_move<is_white>(move);
+#endif
+    trans_table->prefetch(board.get_hash());  // Child is probed right after repetition checks, start loading its bucket now.
+    assert(board.get_hash() == ZobroistHasher::get().hash_board(board));  // Debug cross-check of the incremental hash.
+    assert(board.get_pawn_hash() == ZobroistHasher::get().hash_pawns(board));
+    search_stack[ply + 1].hash = board.get_hash();
+}
+
+void Game::make_null_move(int ply) {
+    search_stack[ply].restore = board.do_null_move();
+    assert(board.get_hash() == ZobroistHasher::get().hash_board(board));
+    search_stack[ply + 1].hash = board.get_hash();
+}
+
+void Game::undo_null_move(int ply) {
+    board.undo_null_move(search_stack[ply].restore);
+    assert(board.get_hash() == search_stack[ply].hash);
 }
 
-template <bool is_white> void Game::undo_move() {
-    Move move = move_stack.top();
-    restore_move_info info = restore_info_stack.top();
-    move_stack.pop();
-    restore_info_stack.pop();
-    board.undo_move<is_white>(info, move);
-    state_stack.pop();
+template <bool is_white> void Game::undo_move(int ply) {
+    const search_stack_entry &entry = search_stack[ply];
+#ifdef COPY_MAKE
+    board.restore<is_white>(entry.snapshot, entry.move);
+#ifdef USE_NNUE
+    if (nnue::enabled)
+        board.set_accumulator(entry.acc);
+#endif
+#else
+    board.undo_move<is_white>(entry.restore, entry.move);
+#endif
+    assert(board.get_hash() == entry.hash);
 }
@@ -4,6 +4,8 @@
 #include <cstdlib>
 #include <iostream>
 #include <movegen.h>
+#include <optional>
+#include <string>
 #include <utility>
 #include <vector>
 using namespace movegen;
@@ -120,7 +122,7 @@ void find_dense(bool rook) {
         uint64_t occ_mask = rook ? rook_occupancy_table[sq] : bishop_occupancy_table[sq];
         int m = rook ? rook_num_occ_bits[sq] : bishop_num_occ_bits[sq];
         std::array<uint64_t, max_size> occ_bbs = gen_occ_variation(occ_mask, m);  // will be size
-        std::array<uint64_t, max_size> atk_bbs = compute_atk_bbs(occ_bbs, sq, rook);
+        std::array<uint64_t, max_size> atk_bbs = compute_atk_bbs(occ_bbs, sq, rook, false);
         int maxiter = 10000000;
         std::optional<std::pair<uint64_t, size_t>> magic_candidate;
         magic_candidate = find_magic_nbr(maxiter, sq, target_bits, rook, occ_bbs, atk_bbs);
@@ -154,7 +156,7 @@ void find_lower_range(bool rook) {
         uint64_t occ_mask = rook ? rook_occupancy_table[sq] : bishop_occupancy_table[sq];
         int m = rook ? rook_num_occ_bits[sq] : bishop_num_occ_bits[sq];
         std::array<uint64_t, max_size> occ_bbs = gen_occ_variation(occ_mask, m);  // will be size
-        std::array<uint64_t, max_size> atk_bbs = compute_atk_bbs(occ_bbs, sq, rook);
+        std::array<uint64_t, max_size> atk_bbs = compute_atk_bbs(occ_bbs, sq, rook, false);
         occs_bbs_sq[sq] = occ_bbs;
         atk_bbs_sq[sq] = atk_bbs;
         magics[sq] = {0, 10000000};
@@ -195,7 +197,7 @@ void find_sparse(bool rook) {
         uint64_t occ_mask = rook ? rook_occupancy_table[sq] : bishop_occupancy_table[sq];
         int m = rook ? rook_num_occ_bits[sq] : bishop_num_occ_bits[sq];
         std::array<uint64_t, max_size> occ_bbs = gen_occ_variation(occ_mask, m);  // will be size
-        std::array<uint64_t, max_size> atk_bbs = compute_atk_bbs(occ_bbs, sq, rook);
+        std::array<uint64_t, max_size> atk_bbs = compute_atk_bbs(occ_bbs, sq, rook, false);
         occs_bbs_sq[sq] = occ_bbs;
         atk_bbs_sq[sq] = atk_bbs;
         int maxiter = 10000;
@@ -214,8 +216,138 @@ void find_sparse(bool rook) {
         std::cout << sq << " " << target_bits << " " << magics[sq].first << "\n";
     }
 }
-int main() {
+/**
+ * @brief One square's part of the shared slider table: the attack set stored under each key, 0
+ * where no occupancy hashes to the key. Attack sets are never 0, so 0 marks a free slot.
+ */
+struct sub_table {
+    bool rook;
+    int sq;
+    uint64_t magic;
+    int bits;
+    std::vector<uint64_t> entries;
+};
+/**
+ * @brief Builds the sub table of a square for a given magic.
+ *
+ * @return the sub table, or nothing if the magic has a destructive collision.
+ */
+std::optional<sub_table> build_sub_table(bool rook, int sq, uint64_t magic, int bits) {
+    int m = rook ? rook_num_occ_bits[sq] : bishop_num_occ_bits[sq];
+    uint64_t occ_mask = rook ? rook_occupancy_table[sq] : bishop_occupancy_table[sq];
+    std::array<uint64_t, max_size> occ_bbs = gen_occ_variation(occ_mask, m);
+    std::array<uint64_t, max_size> atk_bbs = compute_atk_bbs(occ_bbs, sq, rook, false);
+    sub_table table = {rook, sq, magic, bits, std::vector<uint64_t>(1 << bits, 0)};
+    size_t key_maxval = 0;
+    for (int n = 0; n < (1 << m); n++) {
+        size_t key = get_key(occ_bbs[n], magic, bits);
+        if (table.entries[key] != 0 && table.entries[key] != atk_bbs[n])
+            return {};
+        table.entries[key] = atk_bbs[n];
+        key_maxval = std::max(key, key_maxval);
+    }
+    table.entries.resize(key_maxval + 1);  // Keys past the largest used one are free as well.
+    return table;
+}
+/**
+ * @brief Lowest offset in the shared table where a sub table fits: each of its used keys lands on a
+ * free slot or on a slot holding the same attack set. Slots past the end of the table are free.
+ */
+size_t find_fit(const std::vector<uint64_t> &shared, const std::vector<uint64_t> &entries) {
+    for (size_t offset = 0;; offset++) {
+        bool fits = true;
+        for (size_t i = 0; i < entries.size() && offset + i < shared.size(); i++) {
+            uint64_t slot = shared[offset + i];
+            if (entries[i] != 0 && slot != 0 && slot != entries[i]) {
+                fits = false;
+                break;
+            }
+        }
+        if (fits)
+            return offset;
+    }
+}
+/**
+ * @brief Packs all rook and bishop tables into one shared table. The sub tables are placed largest
+ * first, each at the lowest offset where it fits, so later tables fill the keys that earlier ones
+ * leave unused. For every square the current magic, a magic with one bit less and a number of
+ * freshly searched magics with the same bits are tried, and the one whose table ends lowest in the
+ * shared table is kept. Prints the magics, bits and offsets to put in movegen.h.
+ *
+ * @param[in] candidates number of new magics to try per square.
+ * @param[in] dense_iter iterations to search for a magic with one bit less per square.
+ */
+void pack_tables(int candidates, int dense_iter) {
+    std::vector<sub_table> tables;
+    for (bool rook : {true, false}) {
+        for (int sq = 0; sq < 64; sq++) {
+            int bits = rook ? rook_magic_sizes_bits[sq] : bishop_magic_sizes_bits[sq];
+            tables.push_back(build_sub_table(rook, sq, rook ? rook_magics[sq] : bishop_magics[sq], bits).value());
+        }
+    }
+    std::stable_sort(tables.begin(), tables.end(), [](const sub_table &a, const sub_table &b) { return a.entries.size() > b.entries.size(); });
+
+    std::vector<uint64_t> shared;
+    std::array<std::array<uint64_t, 64>, 2> magics;
+    std::array<std::array<size_t, 64>, 2> offsets;
+    std::array<std::array<int, 64>, 2> bits;
+    for (sub_table &table : tables) {
+        int m = table.rook ? rook_num_occ_bits[table.sq] : bishop_num_occ_bits[table.sq];
+        uint64_t occ_mask = table.rook ? rook_occupancy_table[table.sq] : bishop_occupancy_table[table.sq];
+        std::array<uint64_t, max_size> occ_bbs = gen_occ_variation(occ_mask, m);
+        std::array<uint64_t, max_size> atk_bbs = compute_atk_bbs(occ_bbs, table.sq, table.rook, false);
 
-    find_lower_range(true);
+        size_t best_offset = find_fit(shared, table.entries);
+        auto try_magic = [&](int magic_bits, int maxiter) {
+            std::optional<std::pair<uint64_t, size_t>> candidate = find_magic_nbr(maxiter, table.sq, magic_bits, table.rook, occ_bbs, atk_bbs);
+            if (!candidate)
+                return;
+            sub_table other = build_sub_table(table.rook, table.sq, candidate.value().first, magic_bits).value();
+            size_t offset = find_fit(shared, other.entries);
+            if (std::max(shared.size(), offset + other.entries.size()) < std::max(shared.size(), best_offset + table.entries.size())) {
+                table = other;
+                best_offset = offset;
+            }
+        };
+        try_magic(table.bits - 1, dense_iter);  // A denser magic halves the table.
+        for (int i = 0; i < candidates; i++)
+            try_magic(table.bits, 100000);
+        if (shared.size() < best_offset + table.entries.size())
+            shared.resize(best_offset + table.entries.size(), 0);
+        for (size_t i = 0; i < table.entries.size(); i++) {
+            if (table.entries[i] != 0)
+                shared[best_offset + i] = table.entries[i];
+        }
+        magics[table.rook][table.sq] = table.magic;
+        bits[table.rook][table.sq] = table.bits;
+        offsets[table.rook][table.sq] = best_offset;
+        std::cout << "placed " << (table.rook ? "rook " : "bishop ") << table.sq << " at " << best_offset << ", size " << shared.size() << "   \r";
+        fflush(stdout);
+    }
+    std::cout << "\ncurrent table: " << slider_table_sz * sizeof(uint64_t) << " bytes, packed table: " << shared.size() * sizeof(uint64_t) << " bytes, "
+              << std::count(shared.begin(), shared.end(), 0) << " unused entries\n";
+    for (bool rook : {true, false}) {
+        std::cout << (rook ? "rook" : "bishop") << " magics:\n";
+        for (int sq = 0; sq < 64; sq++)
+            std::cout << magics[rook][sq] << ", ";
+        std::cout << "\n" << (rook ? "rook" : "bishop") << " bits:\n";
+        for (int sq = 0; sq < 64; sq++)
+            std::cout << bits[rook][sq] << ", ";
+        std::cout << "\n" << (rook ? "rook" : "bishop") << " offsets:\n";
+        for (int sq = 0; sq < 64; sq++)
+            std::cout << offsets[rook][sq] << ", ";
+        std::cout << "\n";
+    }
+}
+/**
+ * @brief Usage: gen_magics [range | pack [candidates] [dense_iter]]. Defaults to range.
+ */
+int main(int argc, char **argv) {
+    std::string mode = argc > 1 ? argv[1] : "range";
+    if (mode == "pack") {
+        pack_tables(argc > 2 ? std::atoi(argv[2]) : 0, argc > 3 ? std::atoi(argv[3]) : 0);
+    } else {
+        find_lower_range(true);
+    }
     return 0;
 }
@@ -1,17 +1,22 @@
 // Copyright 2025 Filip Agert
 #include "iostream"
 #include "string"
-#include "thread"
 #include "uci_interface.h"
+#include <config.h>
+#include <nnue.h>
 
 int main() {
     std::string input;
     std::cout << "Welcome to the UCI interface!" << std::endl;
+#ifdef USE_NNUE
+    if (nnue::load(DEFAULT_EVAL_FILE))
+        std::cout << "info string Network loaded from " << DEFAULT_EVAL_FILE << std::endl;
+#endif
     std::string command, body;
-    auto sleeptime = 1ms;
 
     do {
-        std::getline(std::cin, input);
+        if (!std::getline(std::cin, input))
+            input = "quit";  // End of input, e.g. the GUI closed the pipe.
         size_t space_pos = input.find(" ");
         if (space_pos == std::string::npos) {
             command = input;
@@ -20,6 +25,10 @@ int main() {
             command = input.substr(0, space_pos);
             body = input.substr(space_pos + 1);
         }
+        // The search runs on its own thread. These commands are answered while it runs, the others
+        // use the game state and wait for it to finish.
+        if (command != "isready" && command != "stop" && command != "ponderhit" && command != "quit")
+            UCIInterface::wait_for_search();
 
         if (command == "uci") {
             UCIInterface::process_uci_command();
@@ -27,12 +36,16 @@ int main() {
             UCIInterface::process_isready_command();
         } else if (command == "go") {
             UCIInterface::process_go_command(body);
+        } else if (command == "setoption") {
+            UCIInterface::process_setoption_command(body);
         } else if (command == "position") {
             UCIInterface::process_position_command(body);
         } else if (command == "bestmove") {
             UCIInterface::send_bestmove();
-        } else if (command == "ponder") {
-            UCIInterface::process_ponder_command();
+        } else if (command == "stop") {
+            UCIInterface::process_stop_command();
+        } else if (command == "ponderhit") {
+            UCIInterface::process_ponderhit_command();
         } else if (command == "newgame") {
             UCIInterface::process_new_game_command();
         } else if (command == "d") {
@@ -44,16 +57,13 @@ int main() {
         } else if (command == "self") {
             UCIInterface::process_self_command(body);
         } else if (command == "debug") {
-            std::cout << "Debug mode is not implemented yet." << std::endl;
+            UCIInterface::uci_response("Debug mode is not implemented yet.");
         } else if (command == "help") {
-            std::cout << "Available commands: uci, isready, go, position, bestmove, ponder, "
-                         "newgame, quit, debug, d, board, help"
-                      << std::endl;
+            UCIInterface::uci_response("Available commands: uci, isready, setoption, go, stop, ponderhit, position, bestmove, "
+                                       "newgame, quit, debug, d, board, help");
         } else {
-            std::cout << "Unknown command: " << input << std::endl;
+            UCIInterface::uci_response("Unknown command: " + input);
         }
-        UCIInterface::send_info_if_has();
-        std::this_thread::sleep_for(sleeptime);
     } while (true);
     return 0;
 }
@@ -4,8 +4,8 @@
 using namespace dirs;
 using namespace masks;
 namespace magic {
-alignas(64) const std::array<uint64_t, rook_magic_table_sz> rook_magic_bitboards = [] {  // precompute the magic bitboards;
-    std::array<uint64_t, rook_magic_table_sz> rook_magic_bbs;
+alignas(64) const std::array<uint64_t, slider_table_sz> slider_attacks = [] {  // precompute the magic bitboards;
+    std::array<uint64_t, slider_table_sz> slider_bbs;
     for (int sq = 0; sq < 64; sq++) {
         std::array<uint64_t, max_size> occ, atk;
         uint64_t occmask = occupancy_bits_rook(sq);
@@ -15,26 +15,20 @@ alignas(64) const std::array<uint64_t, rook_magic_table_sz> rook_magic_bitboards
 
         for (int i = 0; i < nvars; i++) {
             int idx = get_rook_magic_idx(sq, occ[i]);
-            rook_magic_bbs[idx] = atk[i];
+            slider_bbs[idx] = atk[i];
         }
-    }
-    return rook_magic_bbs;
-}();
-alignas(64) const std::array<uint64_t, bishop_magic_table_sz> bishop_magic_bitboards = [] {  // precompute the magic bitboards;
-    std::array<uint64_t, bishop_magic_table_sz> bishop_magic_bbs;
-    for (int sq = 0; sq < 64; sq++) {
-        std::array<uint64_t, max_size> occ, atk;
-        uint64_t occmask = occupancy_bits_bishop(sq);
+
+        occmask = occupancy_bits_bishop(sq);
         occ = gen_occ_variation(occmask, bishop_num_occ_bits[sq]);
         atk = compute_atk_bbs(occ, sq, false, false);
-        int nvars = 1 << bishop_num_occ_bits[sq];
+        nvars = 1 << bishop_num_occ_bits[sq];
 
         for (int i = 0; i < nvars; i++) {
             int idx = get_bishop_magic_idx(sq, occ[i]);
-            bishop_magic_bbs[idx] = atk[i];
+            slider_bbs[idx] = atk[i];
         }
     }
-    return bishop_magic_bbs;
+    return slider_bbs;
 }();
 
 }  // namespace magic
@@ -1,11 +1,37 @@
 // Copyright 2025 Filip Agert
+#include <algorithm>
+#include <atomic>
+#include <bit>
 #include <board.h>
+#include <chrono>
 #include <constants.h>
 #include <iostream>
+#include <memory>
 #include <move.h>
 #include <movegen_benchmark.h>
+#include <moveorder.h>
 #include <string>
-int movegen_benchmark::gen_num_moves(std::string FEN, int depth, int print_depth) {
+#include <thread>
+perft_table::perft_table(size_t size_MB) : arr(std::bit_floor(std::max<size_t>((size_MB << 20) / sizeof(transposition_slot), 1))) {
+    mask = arr.size() - 1;
+}
+std::optional<uint64_t> perft_table::get(uint64_t hash, int depth) const {
+    uint64_t key = depth_key(hash, depth);
+    const transposition_slot &slot = arr[key & mask];
+    uint64_t nodes = slot.data.load(std::memory_order_relaxed);
+    uint64_t check = slot.key.load(std::memory_order_relaxed);
+    if (nodes != 0 && (check ^ nodes) == key)  // Counts of 0 are not worth storing, 0 marks an empty slot.
+        return nodes;
+    return {};
+}
+void perft_table::store(uint64_t hash, int depth, uint64_t nodes) {
+    uint64_t key = depth_key(hash, depth);
+    transposition_slot &slot = arr[key & mask];
+    slot.key.store(key ^ nodes, std::memory_order_relaxed);
+    slot.data.store(nodes, std::memory_order_relaxed);
+}
+
+uint64_t movegen_benchmark::gen_num_moves(std::string FEN, int depth, int print_depth) {
     Board board;
     bool success = board.read_fen(FEN);
     if (!success) {
@@ -14,30 +40,166 @@ int movegen_benchmark::gen_num_moves(std::string FEN, int depth, int print_depth
     }
     return gen_num_moves(board, depth, print_depth);
 }
-int movegen_benchmark::gen_num_moves(Board state, int depth, int print_depth) {
+uint64_t movegen_benchmark::gen_num_moves(Board state, int depth, int print_depth) {
+    std::unique_ptr<move_buffer> move_arr = std::make_unique<move_buffer>();
     bool is_white = state.get_turn_color() == pieces::white;
     if (is_white)
-        return recurse_moves<true>(state, print_depth, 1, depth);
+        return recurse_moves<true>(state, *move_arr, nullptr, print_depth, 1, depth);
     else
-        return recurse_moves<false>(state, print_depth, 1, depth);
+        return recurse_moves<false>(state, *move_arr, nullptr, print_depth, 1, depth);
 }
-std::array<std::array<Move, max_legal_moves>, 32> movegen_benchmark::move_arr;
-template <bool is_white> int movegen_benchmark::recurse_moves(Board state, int print_depth, int curr_depth, int to_depth) {
+template <bool is_white>
+uint64_t movegen_benchmark::recurse_moves(Board &state, move_buffer &move_arr, perft_table *table, int print_depth, int curr_depth, int to_depth) {
     if (curr_depth == to_depth)
-        return state.get_moves<normal_search, is_white>(movegen_benchmark::move_arr[curr_depth]);
+        return state.count_moves<is_white>();
 
-    int num_moves = state.get_moves<normal_search, is_white>(movegen_benchmark::move_arr[curr_depth]);
-    int total_moves = 0;
+    int remaining_depth = to_depth - curr_depth + 1;
+    if (table) {
+        std::optional<uint64_t> stored = table->get(state.get_hash(), remaining_depth);
+        if (stored)
+            return stored.value();
+    }
+
+    int num_moves = state.get_moves<normal_search, is_white>(move_arr[curr_depth]);
+    uint64_t total_moves = 0;
+#ifdef COPY_MAKE
+    // One snapshot serves all moves of the node. The accumulator is not restored, perft does not evaluate.
+    const position_snapshot snapshot = state.snapshot();
+#endif
     for (int i = 0; i < num_moves; i++) {
-        restore_move_info info = state.do_move<is_white>(movegen_benchmark::move_arr[curr_depth][i]);
-        int this_move_nbr = recurse_moves<!is_white>(state, print_depth, curr_depth + 1, to_depth);
+#ifdef COPY_MAKE
+        state.do_move<is_white>(move_arr[curr_depth][i]);
+#else
+        restore_move_info info = state.do_move<is_white>(move_arr[curr_depth][i]);
+#endif
+        uint64_t this_move_nbr = recurse_moves<!is_white>(state, move_arr, table, print_depth, curr_depth + 1, to_depth);
         if (curr_depth <= print_depth) {
             for (int j = 0; j < curr_depth; j++)
                 std::cout << "    ";  // indent by depth
-            std::cout << movegen_benchmark::move_arr[curr_depth][i].toString() << ": " << this_move_nbr << "\n";
+            std::cout << move_arr[curr_depth][i].toString() << ": " << this_move_nbr << "\n";
         }
         total_moves += this_move_nbr;
-        state.undo_move<is_white>(info, movegen_benchmark::move_arr[curr_depth][i]);
+#ifdef COPY_MAKE
+        state.restore<is_white>(snapshot, move_arr[curr_depth][i]);
+#else
+        state.undo_move<is_white>(info, move_arr[curr_depth][i]);
+#endif
     }
+    if (table)
+        table->store(state.get_hash(), remaining_depth, total_moves);
     return total_moves;
 }
+
+uint64_t movegen_benchmark::gen_num_moves_parallel(Board board, int depth, int threads, size_t hash_MB, bool print_root) {
+    if (board.get_turn_color() == pieces::white)
+        return gen_num_moves_parallel<true>(board, depth, threads, hash_MB, print_root);
+    else
+        return gen_num_moves_parallel<false>(board, depth, threads, hash_MB, print_root);
+}
+template <bool is_white>
+uint64_t movegen_benchmark::gen_num_moves_parallel(Board &board, int depth, int threads, size_t hash_MB, bool print_root) {
+    std::unique_ptr<perft_table> table = hash_MB > 0 ? std::make_unique<perft_table>(hash_MB) : nullptr;
+    if (depth <= 1)
+        return board.count_moves<is_white>();
+    std::array<Move, max_legal_moves> root_moves;
+    int num_root = board.get_moves<normal_search, is_white>(root_moves);
+
+    // Split two plies below the root: a few hundred subtrees keeps all threads busy even when one
+    // root move has a much larger subtree than the others.
+    struct task {
+        Board board;
+        int root_idx;
+    };
+    std::vector<task> tasks;
+    std::vector<uint64_t> leaf_counts(num_root, 0);  // root moves where depth 2 is the leaf.
+    for (int i = 0; i < num_root; i++) {
+        restore_move_info info = board.do_move<is_white>(root_moves[i]);
+        if (depth == 2) {
+            leaf_counts[i] = board.count_moves<!is_white>();
+        } else {
+            std::array<Move, max_legal_moves> replies;
+            int num_replies = board.get_moves<normal_search, !is_white>(replies);
+            for (int j = 0; j < num_replies; j++) {
+                restore_move_info reply_info = board.do_move<!is_white>(replies[j]);
+                tasks.push_back({board, i});
+                board.undo_move<!is_white>(reply_info, replies[j]);
+            }
+        }
+        board.undo_move<is_white>(info, root_moves[i]);
+    }
+
+    std::unique_ptr<std::atomic<uint64_t>[]> root_counts = std::make_unique<std::atomic<uint64_t>[]>(num_root);
+    std::atomic<size_t> next_task = 0;
+    auto worker = [&] {
+        std::unique_ptr<move_buffer> move_arr = std::make_unique<move_buffer>();
+        for (size_t t = next_task.fetch_add(1); t < tasks.size(); t = next_task.fetch_add(1)) {
+            uint64_t nodes = recurse_moves<is_white>(tasks[t].board, *move_arr, table.get(), -1, 3, depth);
+            root_counts[tasks[t].root_idx].fetch_add(nodes, std::memory_order_relaxed);
+        }
+    };
+    std::vector<std::thread> pool;
+    for (int i = 1; i < threads; i++)
+        pool.emplace_back(worker);
+    worker();
+    for (std::thread &t : pool)
+        t.join();
+
+    uint64_t total_moves = 0;
+    for (int i = 0; i < num_root; i++) {
+        uint64_t this_move_nbr = root_counts[i].load() + leaf_counts[i];
+        if (print_root)
+            std::cout << "    " << root_moves[i].toString() << ": " << this_move_nbr << "\n";
+        total_moves += this_move_nbr;
+    }
+    return total_moves;
+}
+
+template <bool is_white> void movegen_benchmark::collect_move_lists(Board &board, int depth, scored_move_lists &lists) {
+    std::array<Move, max_legal_moves> moves;
+    size_t num_moves = board.get_moves<normal_search, is_white>(moves);
+    for (size_t i = 0; i < num_moves; i++) {
+        lists.moves.push_back(moves[i]);
+        lists.scores.push_back(MoveOrder::move_heuristics<is_white>(moves[i], board));
+    }
+    lists.offsets.push_back(lists.moves.size());
+    if (depth <= 1)
+        return;
+    for (size_t i = 0; i < num_moves; i++) {
+        restore_move_info info = board.do_move<is_white>(moves[i]);
+        collect_move_lists<!is_white>(board, depth - 1, lists);
+        board.undo_move<is_white>(info, moves[i]);
+    }
+}
+int64_t movegen_benchmark::sort_benchmark(Board board, int depth) {
+    scored_move_lists lists;
+    if (board.get_turn_color() == pieces::white)
+        collect_move_lists<true>(board, depth, lists);
+    else
+        collect_move_lists<false>(board, depth, lists);
+
+    const int64_t num_lists = lists.offsets.size() - 1;
+    constexpr int64_t min_sorts = 1000000;  // Repeat the lists until enough sorts are timed.
+    const int64_t repeats = std::max<int64_t>(1, min_sorts / num_lists);
+    std::array<Move, max_legal_moves> moves;
+    std::array<int, max_legal_moves> scores;
+    int64_t checksum = 0;  // Keeps the copies and sorts from being optimised away.
+    auto run = [&](bool sort) {
+        auto start = std::chrono::high_resolution_clock::now();
+        for (int64_t r = 0; r < repeats; r++) {
+            for (int64_t l = 0; l < num_lists; l++) {
+                size_t begin = lists.offsets[l];
+                size_t num_moves = lists.offsets[l + 1] - begin;
+                std::copy_n(lists.moves.begin() + begin, num_moves, moves.begin());
+                std::copy_n(lists.scores.begin() + begin, num_moves, scores.begin());
+                if (sort)
+                    MoveOrder::partial_move_sort(moves, scores, num_moves, false);
+                checksum += moves[0].to_bits();
+            }
+        }
+        return std::chrono::high_resolution_clock::now() - start;
+    };
+    std::chrono::nanoseconds duration = run(true) - run(false);
+    if (checksum == -1)
+        std::cout << checksum << std::endl;
+    return duration.count() / (repeats * num_lists);
+}
@@ -0,0 +1,91 @@
+// Copyright 2025 Filip Agert
+#include <algorithm>
+#include <fstream>
+#include <memory>
+#include <nnue.h>
+#if defined(__AVX2__) || defined(__SSE2__)
+#include <immintrin.h>
+#endif
+
+bool nnue::load(const std::string &path) {
+    std::ifstream file(path, std::ios::binary | std::ios::ate);
+    if (!file)
+        return false;
+    constexpr std::streamsize expected = sizeof(int16_t) * (num_features * hidden + hidden + 2 * hidden + 1);
+    if (file.tellg() != expected)
+        return false;
+    file.seekg(0);
+    // Read into a copy so a failed read keeps the previous network. Assumes a little endian host.
+    std::unique_ptr<network> read = std::make_unique<network>();
+    file.read(reinterpret_cast<char *>(read->feature_weights.data()), sizeof(read->feature_weights));
+    file.read(reinterpret_cast<char *>(read->feature_bias.data()), sizeof(read->feature_bias));
+    file.read(reinterpret_cast<char *>(read->output_weights.data()), sizeof(read->output_weights));
+    file.read(reinterpret_cast<char *>(&read->output_bias), sizeof(read->output_bias));
+    if (!file)
+        return false;
+    net = *read;
+    loaded = true;
+    enabled = use;
+    return true;
+}
+void nnue::set_use(bool use_nnue) {
+    use = use_nnue;
+    enabled = loaded && use;
+}
+
+namespace {
+/**
+ * @brief Sum over i of clamp(acc[i], 0, QA) * weights[i].
+ */
+int32_t crelu_dot_scalar(const int16_t *acc, const int16_t *weights) {
+    int32_t sum = 0;
+    for (int i = 0; i < nnue::hidden; i++)
+        sum += std::clamp<int32_t>(acc[i], 0, nnue::QA) * weights[i];
+    return sum;
+}
+#if defined(__AVX2__)
+int32_t crelu_dot(const int16_t *acc, const int16_t *weights) {
+    const __m256i zero = _mm256_setzero_si256();
+    const __m256i qa = _mm256_set1_epi16(nnue::QA);
+    __m256i sum = _mm256_setzero_si256();
+    for (int i = 0; i < nnue::hidden; i += 16) {
+        __m256i v = _mm256_load_si256(reinterpret_cast<const __m256i *>(acc + i));
+        v = _mm256_min_epi16(_mm256_max_epi16(v, zero), qa);
+        __m256i w = _mm256_load_si256(reinterpret_cast<const __m256i *>(weights + i));
+        sum = _mm256_add_epi32(sum, _mm256_madd_epi16(v, w));  // Pairs of int16 products summed to int32.
+    }
+    __m128i sum128 = _mm_add_epi32(_mm256_castsi256_si128(sum), _mm256_extracti128_si256(sum, 1));
+    sum128 = _mm_add_epi32(sum128, _mm_shuffle_epi32(sum128, _MM_SHUFFLE(1, 0, 3, 2)));
+    sum128 = _mm_add_epi32(sum128, _mm_shuffle_epi32(sum128, _MM_SHUFFLE(2, 3, 0, 1)));
+    return _mm_cvtsi128_si32(sum128);
+}
+#elif defined(__SSE2__)
+int32_t crelu_dot(const int16_t *acc, const int16_t *weights) {
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i qa = _mm_set1_epi16(nnue::QA);
+    __m128i sum = _mm_setzero_si128();
+    for (int i = 0; i < nnue::hidden; i += 8) {
+        __m128i v = _mm_load_si128(reinterpret_cast<const __m128i *>(acc + i));
+        v = _mm_min_epi16(_mm_max_epi16(v, zero), qa);
+        __m128i w = _mm_load_si128(reinterpret_cast<const __m128i *>(weights + i));
+        sum = _mm_add_epi32(sum, _mm_madd_epi16(v, w));
+    }
+    sum = _mm_add_epi32(sum, _mm_shuffle_epi32(sum, _MM_SHUFFLE(1, 0, 3, 2)));
+    sum = _mm_add_epi32(sum, _mm_shuffle_epi32(sum, _MM_SHUFFLE(2, 3, 0, 1)));
+    return _mm_cvtsi128_si32(sum);
+}
+#else
+int32_t crelu_dot(const int16_t *acc, const int16_t *weights) { return crelu_dot_scalar(acc, weights); }
+#endif
+}  // namespace
+
+int nnue::evaluate(const accumulator &acc, bool white_to_move) {
+    int32_t sum = crelu_dot(acc.values[white_to_move].data(), net.output_weights.data()) +
+                  crelu_dot(acc.values[!white_to_move].data(), net.output_weights.data() + hidden);
+    return static_cast<int64_t>(sum + net.output_bias) * SCALE / (QA * QB);
+}
+int nnue::evaluate_scalar(const accumulator &acc, bool white_to_move) {
+    int32_t sum = crelu_dot_scalar(acc.values[white_to_move].data(), net.output_weights.data()) +
+                  crelu_dot_scalar(acc.values[!white_to_move].data(), net.output_weights.data() + hidden);
+    return static_cast<int64_t>(sum + net.output_bias) * SCALE / (QA * QB);
+}
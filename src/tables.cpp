@@ -1,29 +1,23 @@
 // Copyright 2025 Filip Agert
+#include <algorithm>
+#include <bit>
 #include <bitboard.h>
+#include <climits>
 #include <cstdlib>
+#include <memory>
+#include <new>
 #include <piece.h>
 #include <random>
 #include <tables.h>
+#ifdef __linux__
+#include <sys/mman.h>
+#endif
 
 void ZobroistHasher::initialize_engine() {
     std::random_device sd;
     engine.seed(sd());
 }
 uint64_t ZobroistHasher::rand_uint64_t() { return generator(engine); }
-void ZobroistHasher::randomize_local_vars() {
-    for (int p = 0; p < 12; p++) {
-        for (int sq = 0; sq < 64; sq++) {
-            piece_numbers[p][sq] = rand_uint64_t();
-        }
-    }
-    for (int i = 0; i < 16; i++) {
-        castle_numbers[i] = rand_uint64_t();
-    }
-    for (int i = 0; i < 8; i++) {
-        ep_numbers[i] = rand_uint64_t();
-    }
-    black_number = rand_uint64_t();
-}
 template <Piece_t p, bool is_white> void ZobroistHasher::hash_piece(uint64_t &hash, const Board &board) {
     BB piece_bb = board.get_piece_bb<p, is_white>();
     constexpr uint8_t key = piece_key<p, is_white>();
@@ -39,8 +33,7 @@ template <Piece_t p> void ZobroistHasher::hash_both_piece(uint64_t &hash, const
 }
 void ZobroistHasher::hash_ep(uint64_t &hash, const Board &board) {
     if (board.get_en_passant()) {
-        uint8_t ep_file = NotationInterface::col(board.get_en_passant_square());
-        hash ^= ep_numbers[ep_file];
+        hash ^= zobrist::ep(board.get_en_passant_square());
     }
 }
 uint64_t ZobroistHasher::hash_board(const Board &board) {
@@ -56,20 +49,91 @@ uint64_t ZobroistHasher::hash_board(const Board &board) {
     hash_turn(hash, board);
     return hash;
 }
-std::optional<transposition_entry> transposition_table::get(uint64_t hash) {
-    size_t key = get_key(hash);
-    transposition_entry curr = arr[key];
-    std::optional<transposition_entry> maybe;
-    if (curr.hash == (hash >> transposition_entry::shift_hash) && curr.nodetype != transposition_entry::invalid) {
-        hits++;
-        maybe = std::make_optional(curr);
-    } else {
-        maybe = {};
-        misses++;
-        if (curr.hash != 0) {
-            collisions++;
+uint64_t ZobroistHasher::hash_pawns(const Board &board) {
+    uint64_t hash = 0;
+    hash_both_piece<pieces::pawn>(hash, board);
+    return hash;
+}
+void transposition_table::resize(size_t size_MB) {
+    size_t max_buckets = std::max<size_t>((size_MB << 20) / sizeof(transposition_bucket), 1);
+    num_buckets = std::bit_floor(max_buckets);
+    mask = num_buckets - 1;
+    allocate();
+    clear();
+}
+void transposition_table::allocate() {
+    arr.reset();  // free old table before allocating the new one.
+    huge_pages = false;
+    size_t bytes = num_buckets * sizeof(transposition_bucket);
+    void *mem = nullptr;
+#ifdef __linux__
+    constexpr size_t huge_page_size = 2 << 20;
+    if (bytes >= huge_page_size) {  // bytes is a power of two, so a multiple of the alignment.
+        mem = std::aligned_alloc(huge_page_size, bytes);
+        if (mem)
+            huge_pages = madvise(mem, bytes, MADV_HUGEPAGE) == 0;
+    }
+#endif
+    if (!mem)
+        mem = std::aligned_alloc(alignof(transposition_bucket), bytes);
+    if (!mem)
+        throw std::bad_alloc();
+    transposition_bucket *buckets = static_cast<transposition_bucket *>(mem);
+    std::uninitialized_default_construct_n(buckets, num_buckets);
+    arr.reset(buckets);
+}
+void transposition_table::clear() {
+    for (size_t i = 0; i < num_buckets; i++) {
+        for (transposition_slot &slot : arr[i].slots) {
+            slot.key.store(0, std::memory_order_relaxed);
+            slot.data.store(0, std::memory_order_relaxed);
+        }
+    }
+    age = 0;
+}
+std::optional<transposition_entry> transposition_table::get(uint64_t hash) const {
+    const transposition_bucket &bucket = arr[get_key(hash)];
+    for (const transposition_slot &slot : bucket.slots) {
+        uint64_t data = slot.data.load(std::memory_order_relaxed);
+        uint64_t check = slot.key.load(std::memory_order_relaxed);
+        if (data != 0 && (check ^ data) == hash) {  // data is never 0 for a stored entry since it holds a valid move.
+            return std::make_optional(transposition_entry::unpack(hash, data));
+        }
+    }
+    return {};
+}
+void transposition_table::store(uint64_t hash, Move bestmove, int eval, uint8_t nodetype, uint8_t depth) {
+    assert(bestmove.source != bestmove.target);
+    transposition_bucket &bucket = arr[get_key(hash)];
+    transposition_slot *replace = &bucket.slots[0];
+    int worst_score = INT32_MAX;
+    for (transposition_slot &slot : bucket.slots) {
+        uint64_t data = slot.data.load(std::memory_order_relaxed);
+        uint64_t check = slot.key.load(std::memory_order_relaxed);
+        if (data == 0 || (check ^ data) == hash) {  // empty or same position.
+            replace = &slot;
+            break;
+        }
+        transposition_entry old = transposition_entry::unpack(check ^ data, data);
+        int age_diff = (age - old.age) & transposition_entry::age_mask;
+        int score = old.depth - 8 * age_diff;  // one search generation is worth 8 plies.
+        if (score < worst_score) {
+            worst_score = score;
+            replace = &slot;
+        }
+    }
+    uint64_t data = transposition_entry{hash, nodetype, depth, eval, bestmove, age}.pack();
+    replace->key.store(hash ^ data, std::memory_order_relaxed);
+    replace->data.store(data, std::memory_order_relaxed);
+}
+int transposition_table::load_factor() const {
+    size_t samples = std::min<size_t>(1000, num_buckets);
+    int filled = 0;
+    for (size_t i = 0; i < samples; i++) {
+        for (const transposition_slot &slot : arr[i].slots) {
+            uint64_t data = slot.data.load(std::memory_order_relaxed);
+            filled += data != 0 && transposition_entry::unpack(0, data).age == age;
         }
     }
-    return maybe;
+    return filled * 1000 / (samples * transposition_bucket::num_slots);
 }
-int transposition_table::load_factor() const { return writes > 0 ? (overwrites * 1000) / writes : 0; }
@@ -16,7 +16,7 @@ void TimeManager::start_time_management() {
     int64_t target_time = calculate_target_move_time_ms();
     this->start = high_resolution_clock::now();
 
-    if (target_time != -1) {
+    if (target_time != -1) {  // Pondering without a clock is infinite too, only stop or ponderhit ends it.
         this->timer_thread = std::thread(&TimeManager::time_loop_function, this, target_time);
     }
 }
@@ -24,6 +24,8 @@ int64_t TimeManager::calculate_target_move_time_ms() {
     int64_t target_time;
     if (this->infinite) {
         return -1;
+    } else if (this->movetime > 0) {
+        target_time = movetime - buffer;
     } else {
         int64_t base_time = remtime / this->remtime_frac;  // Use up 1/20th of the remaining time plus increment.
 
@@ -44,13 +46,15 @@ void TimeManager::time_loop_function(int64_t target_move_time_ms) {
 
         std::this_thread::sleep_for(check_interval);
 
-        int64_t elapsed_time = calculate_time_elapsed_ms();
+        if (pondering.load())
+            continue;
+        int64_t elapsed_time = calculate_time_elapsed_ms() - budget_start.load();
 
         if (elapsed_time >= target_move_time_ms) {
             this->set_should_stop(true);
             break;
         }
-        if (elapsed_time >= target_move_time_ms / 2) {
+        if (movetime == 0 && elapsed_time >= target_move_time_ms / 2) {  // A fixed move time is used up fully.
             this->set_should_start_next_iteration(false);
         }
     }
@@ -76,14 +80,26 @@ int TimeManager::calculate_time_elapsed_ms() const {
     return duration.count();
 }
 
-TimeManager::TimeManager(time_control rem_time, int buffer, int remtime_frac, bool is_white) {
+void TimeManager::ponderhit() {
+    budget_start.store(calculate_time_elapsed_ms());
+    pondering.store(false);
+}
+
+TimeManager::TimeManager(time_control rem_time, int buffer, int remtime_frac, bool is_white)
+    : TimeManager(search_limits{.clock = rem_time}, buffer, remtime_frac, is_white) {}
+TimeManager::TimeManager(const search_limits &limits, int buffer, int remtime_frac, bool is_white) {
+    time_control rem_time = limits.clock.value_or(time_control{0, 0, 0, 0});
     this->remtime = is_white ? rem_time.wtime : rem_time.btime;
     this->enemy_remtime = is_white ? rem_time.btime : rem_time.wtime;
     this->inc = is_white ? rem_time.winc : rem_time.binc;
     this->enemy_inc = is_white ? rem_time.binc : rem_time.winc;
-    this->infinite = false;
+    this->movetime = limits.movetime;
+    this->infinite = limits.infinite || (!limits.clock && limits.movetime == 0);
     this->buffer = buffer;
     this->remtime_frac = remtime_frac;
+    this->pondering.store(limits.ponder);
+    this->budget_start.store(0);
+    this->start = high_resolution_clock::now();
     this->set_should_start_next_iteration(true);
     this->set_should_stop(false);
 }
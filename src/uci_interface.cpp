@@ -1,11 +1,13 @@
 #include "uci_interface.h"
+#include <algorithm>
 #include <chrono>
 #include <config.h>
 #include <cstdlib>
 #include <eval.h>
-#include <exceptions.h>
+#include <iomanip>
 #include <iostream>
 #include <movegen_benchmark.h>
+#include <nnue.h>
 #include <sstream>
 #include <string>
 #include <time_manager.h>
@@ -13,11 +15,19 @@
 void UCIInterface::process_uci_command() {
     UCIInterface::uci_response("id name " + ID_name);
     UCIInterface::uci_response("id author " + ID_author);
+    UCIInterface::uci_response("option name Hash type spin default " + std::to_string(DEFAULT_HASH_MB) + " min 1 max " + std::to_string(MAX_HASH_MB));
+    UCIInterface::uci_response("option name Threads type spin default 1 min 1 max " + std::to_string(MAX_THREADS));
+#ifdef USE_NNUE
+    UCIInterface::uci_response("option name UseNNUE type check default true");
+    UCIInterface::uci_response("option name EvalFile type string default " + DEFAULT_EVAL_FILE);
+#endif
     UCIInterface::uci_response("uciok");
 }
 
 void UCIInterface::process_isready_command() { UCIInterface::uci_response("readyok"); }
 void UCIInterface::process_quit_command() {
+    process_stop_command();
+    wait_for_search();
     UCIInterface::uci_response("Exiting...");
     exit(0);
 }
@@ -39,6 +49,10 @@ void UCIInterface::send_info_msg(InfoMsg msg) {
         } else {
             parts.push_back("score cp " + std::to_string(msg.score));
         }
+        if (msg.lowerbound)
+            parts.push_back("lowerbound");
+        else if (msg.upperbound)
+            parts.push_back("upperbound");
         parts.push_back("time " + std::to_string(msg.time));
         parts.push_back("nodes " + std::to_string(msg.nodes));
 
@@ -60,86 +74,148 @@ void UCIInterface::send_info_msg(InfoMsg msg) {
     std::string final_str = join(parts, ' ');
 
     UCIInterface::uci_response(final_str);
+    if (!msg.stringmsg && !msg.lowerbound && !msg.upperbound) {  // Search statistics are not UCI info fields, so sent as a string.
+        std::ostringstream stats;
+        stats << "info string";
+        if (msg.ebf > 0)
+            stats << " ebf " << std::fixed << std::setprecision(2) << msg.ebf;
+        stats << " rfp " << msg.reverse_futility_prunes << " futility " << msg.futility_prunes << " delta " << msg.delta_prunes;
+        stats << " pawnhash " << std::fixed << std::setprecision(1) << msg.pawn_hash_hits * 100 << "%";
+        stats << " evalcache " << std::fixed << std::setprecision(1) << msg.eval_cache_hits * 100 << "%";
+        stats << " allocs " << msg.allocations;
+        UCIInterface::uci_response(stats.str());
+    }
 }
 void UCIInterface::send_info_if_has() {
-    for (; !Game::instance().info_queue.empty(); Game::instance().info_queue.pop()) {
-        InfoMsg info = Game::instance().info_queue.front();
-        UCIInterface::send_info_msg(info);
-    }
+    while (std::optional<InfoMsg> info = Game::instance().info_queue.pop())
+        UCIInterface::send_info_msg(info.value());
 }
 void UCIInterface::process_go_command(std::string command) {
+    wait_for_search();
     // Initialize board:
     if (debug_mode)
         UCIInterface::uci_response("Processing go command: " + command);
-    int wtime, btime, winc, binc;
-    wtime = btime = STANDARD_TIME;
-    winc = binc = STANDARD_TINC;
+    search_limits limits;
+    time_control clock = {.wtime = STANDARD_TIME, .btime = STANDARD_TIME, .winc = STANDARD_TINC, .binc = STANDARD_TINC};
+    bool has_clock = false;
     auto parts = split(command, ' ');
     if (parts.size() > 0) {
         if (parts[0] == "perft") {
-            if (parts.size() < 3) {
-                UCIInterface::uci_response("A perft command must have the structure go perft <depth> <print_depth>");
+            if (parts.size() < 2) {
+                UCIInterface::uci_response("A perft command must have the structure go perft <depth> [print_depth] [threads <n>] [hash <MB>]");
                 return;
             }
 
             std::string int_token = parts[1];
             int depth;
-            int print_depth;
+            int print_depth = -1;
+            int threads = 1;
+            int hash_MB = 0;
             try {
                 depth = std::stoi(int_token);
-                print_depth = std::stoi(parts[2]);
+                for (size_t idx = 2; idx < parts.size(); idx++) {
+                    int_token = parts[idx];
+                    if (parts[idx] == "threads" && idx + 1 < parts.size())
+                        threads = std::stoi(int_token = parts[++idx]);
+                    else if (parts[idx] == "hash" && idx + 1 < parts.size())
+                        hash_MB = std::stoi(int_token = parts[++idx]);
+                    else
+                        print_depth = std::stoi(int_token);
+                }
             } catch (const ::std::exception &e) {
                 UCIInterface::uci_response("Error: \"perft\" command should be followed by an integer but found: " + int_token);
                 return;
             }
-            int nodes = movegen_benchmark::gen_num_moves(Game::instance().get_board(), depth, print_depth);
+            uint64_t nodes;
+            if (threads > 1 || hash_MB > 0)  // Only the root branches are printed.
+                nodes = movegen_benchmark::gen_num_moves_parallel(Game::instance().get_board(), depth, std::clamp(threads, 1, MAX_THREADS), hash_MB,
+                                                                  print_depth >= 1);
+            else
+                nodes = movegen_benchmark::gen_num_moves(Game::instance().get_board(), depth, print_depth);
             std::string nodes_searched = std::to_string(nodes);
             UCIInterface::uci_response("\nNodes searched: " + nodes_searched);
             return;
         } else {
-
-            // Process wtime <> btime <> winc <> binc<>
-            // Alterantively infinite
-            size_t idx = 0;
-            while (idx < parts.size()) {
+            // Process wtime <> btime <> winc <> binc <> movetime <> depth <> nodes <> mate <>
+            // Alternatively infinite and ponder, which take no value.
+            const std::vector<std::string> int_tokens = {"wtime", "btime", "winc", "binc", "movetime", "depth", "nodes", "mate"};
+            for (size_t idx = 0; idx < parts.size(); idx++) {
                 std::string token = parts[idx];
-                std::optional<int> oint;
-                if (token == "wtime") {
-                    oint = try_process_int(parts[idx + 1]);
-                    if (oint) {
-                        wtime = oint.value();
-                        idx++;
-                    }
-                } else if (token == "btime") {
-                    oint = try_process_int(parts[idx + 1]);
-                    if (oint) {
-                        btime = oint.value();
-                        idx++;
+                if (token == "infinite") {
+                    limits.infinite = true;
+                } else if (token == "ponder") {
+                    limits.ponder = true;
+                } else if (std::find(int_tokens.begin(), int_tokens.end(), token) != int_tokens.end() && idx + 1 < parts.size()) {
+                    std::optional<int> oint = try_process_int(parts[idx + 1]);
+                    if (!oint)
+                        continue;
+                    idx++;
+                    int value = oint.value();
+                    if (token == "wtime") {
+                        clock.wtime = value;
+                        has_clock = true;
+                    } else if (token == "btime") {
+                        clock.btime = value;
+                        has_clock = true;
+                    } else if (token == "winc") {
+                        clock.winc = value;
+                    } else if (token == "binc") {
+                        clock.binc = value;
+                    } else if (token == "movetime") {
+                        limits.movetime = value;
+                    } else if (token == "depth") {
+                        limits.depth = value;
+                    } else if (token == "nodes") {
+                        limits.nodes = value;
+                    } else if (token == "mate") {
+                        limits.mate = value;
                     }
-
-                } else if (token == "binc") {
-                    oint = try_process_int(parts[idx + 1]);
-                    if (oint) {
-                        binc = oint.value();
-                        idx++;
-                    }
-                } else if (token == "winc") {
-                    oint = try_process_int(parts[idx + 1]);
-                    if (oint) {
-                        winc = oint.value();
-                        idx++;
-                    }
-                } else if (token == "infinite") {
-                    NotImplemented("Infinite time control is not implemented yet");  // TODO: Implement.
                 }
-                idx++;
             }
         }
     }
-    time_control rem_time = time_control({.wtime = wtime, .btime = btime, .winc = winc, .binc = binc});
-    Game::instance().start_thinking(rem_time);  // Enter ponder loop
-    UCIInterface::send_info_if_has();
-    UCIInterface::send_bestmove();
+    bool has_limit = limits.movetime > 0 || limits.depth > 0 || limits.nodes > 0 || limits.mate > 0 || limits.infinite;
+    if (has_clock || !has_limit)
+        limits.clock = clock;  // A bare go searches on the default clock.
+    Game::instance().reset_signals();
+    current_limits = limits;
+    hold_bestmove = limits.infinite || limits.ponder;
+    search_thread = std::thread(run_search, limits);
+}
+void UCIInterface::run_search(search_limits limits) {
+    std::atomic<bool> searching = true;
+    std::thread printer([&searching] {
+        while (searching.load()) {
+            send_info_if_has();
+            std::this_thread::sleep_for(std::chrono::milliseconds(INFO_POLL_MS));
+        }
+        send_info_if_has();
+    });
+    Game::instance().start_thinking(limits);
+    hold_bestmove.wait(true);  // In infinite and ponder mode bestmove may only be sent after stop or ponderhit.
+    searching = false;
+    printer.join();
+    send_bestmove();
+}
+void UCIInterface::wait_for_search() {
+    if (!search_thread.joinable())
+        return;
+    if (current_limits.infinite || current_limits.ponder)
+        process_stop_command();
+    search_thread.join();
+}
+void UCIInterface::process_stop_command() {
+    Game::instance().stop();
+    hold_bestmove = false;
+    hold_bestmove.notify_all();
+}
+void UCIInterface::process_ponderhit_command() {
+    current_limits.ponder = false;
+    Game::instance().ponderhit();
+    if (!current_limits.infinite) {
+        hold_bestmove = false;
+        hold_bestmove.notify_all();
+    }
 }
 
 std::optional<int> UCIInterface::try_process_int(std::string intstring) {
@@ -216,7 +292,6 @@ void UCIInterface::process_position_command(std::string command) {
     }
 }
 
-void UCIInterface::process_ponder_command() { UCIInterface::uci_response("Processing ponder command."); }
 void UCIInterface::send_bestmove() {
     Move bestmove = Game::instance().get_bestmove();
     UCIInterface::uci_response("bestmove " + bestmove.toString());
@@ -227,13 +302,25 @@ void UCIInterface::process_d_command() {
     Game::instance().display_board();
     UCIInterface::uci_response(Game::instance().get_fen());
     Board board = Game::instance().get_board();
+    board.refresh_accumulator();
     int eval = EvalState::eval(board);
     UCIInterface::uci_response("Board evaluation (0 depth): " + std::to_string(eval));
 }
 void UCIInterface::process_bench_command(std::string command) {
     // Should be structured like:
     // <fentype> <depth> <threads>
+    // or search <fentype> <depth>
+    // or sort <fentype> <depth>
     std::vector<std::string> parts = UCIInterface::split(command, ' ');
+    if (!parts.empty() && parts[0] == "search") {
+        parts.erase(parts.begin());
+        process_bench_search_command(parts);
+        return;
+    } else if (!parts.empty() && parts[0] == "sort") {
+        parts.erase(parts.begin());
+        process_bench_sort_command(parts);
+        return;
+    }
     int depthloc = 1;
     if (parts.size() == 8) {
         std::vector<std::string> fenparts = parts;
@@ -257,18 +344,101 @@ void UCIInterface::process_bench_command(std::string command) {
     }
 
     int depth = std::stoi(parts[depthloc]);
-    // int threads = std::stoi(parts[depthloc + 1]);
-    UCIInterface::uci_response("Generating moves to depth: " + std::to_string(depth));
+    int threads = std::clamp(std::stoi(parts[depthloc + 1]), 1, MAX_THREADS);
+    UCIInterface::uci_response("Generating moves to depth: " + std::to_string(depth) + " with " + std::to_string(threads) + " threads");
     auto start = std::chrono::high_resolution_clock::now();
-    int64_t nummoves = movegen_benchmark::gen_num_moves(Game::instance().get_board(), depth, -1);
+    int64_t nummoves = threads > 1 ? movegen_benchmark::gen_num_moves_parallel(Game::instance().get_board(), depth, threads)
+                                   : movegen_benchmark::gen_num_moves(Game::instance().get_board(), depth, -1);
     auto stop = std::chrono::high_resolution_clock::now();
     auto duration = std::chrono::duration_cast<std::chrono::milliseconds>(stop - start);
     UCIInterface::uci_response(std::to_string(nummoves) + " nodes found at this depth.");
     UCIInterface::uci_response("Time taken: " + std::to_string(duration.count()) + " ms.");
-    int64_t mps = (1000 * nummoves / duration.count());
+    int64_t mps = (1000 * nummoves / std::max<int64_t>(duration.count(), 1));
     UCIInterface::uci_response("Nodes per second: " + std::to_string(mps));
 }
 
+std::optional<int> UCIInterface::set_bench_position(std::vector<std::string> parts) {
+    int depthloc = 1;
+    if (parts.size() == 7) {
+        constexpr int fenl = 6;
+        std::vector<std::string> fenparts(parts.begin(), parts.begin() + fenl);
+        depthloc = fenl;
+        Game::instance().set_fen(UCIInterface::join(fenparts, ' '));
+    } else if (parts.size() == 2 && parts[0] == "default") {
+        Game::instance().set_startpos();
+    } else if (!(parts.size() == 2 && parts[0] == "current")) {
+        UCIInterface::uci_response("Invalid bench command structure. Must be <search|sort> <fentype> <depth>.");
+        return {};
+    }
+    return try_process_int(parts[depthloc]);
+}
+void UCIInterface::process_bench_sort_command(std::vector<std::string> parts) {
+    std::optional<int> depth = set_bench_position(parts);
+    if (!depth)
+        return;
+    int64_t ns = movegen_benchmark::sort_benchmark(Game::instance().get_board(), depth.value());
+    UCIInterface::uci_response("Sorting move lists of all nodes to depth " + std::to_string(depth.value()));
+    UCIInterface::uci_response("Time per move list: " + std::to_string(ns) + " ns.");
+}
+void UCIInterface::process_bench_search_command(std::vector<std::string> parts) {
+    std::optional<int> depth = set_bench_position(parts);
+    if (!depth)
+        return;
+    UCIInterface::uci_response("Searching to depth: " + std::to_string(depth.value()) + " with " + std::to_string(Game::instance().get_threads()) +
+                               " threads and " + std::to_string(Game::instance().get_hash_size()) + " MB hash" +
+                               (Game::instance().uses_huge_pages() ? " (huge pages)." : "."));
+    constexpr int bench_time = 1000 * 60 * 60 * 24;  // Never hit by the time manager, depth ends the search.
+    time_control rem_time = time_control({.wtime = bench_time, .btime = bench_time, .winc = 0, .binc = 0});
+    auto start = std::chrono::high_resolution_clock::now();
+    Game::instance().start_thinking(rem_time, depth.value());
+    auto stop = std::chrono::high_resolution_clock::now();
+    while (Game::instance().info_queue.pop()) {  // Only the summary is of interest.
+    }
+    auto duration = std::chrono::duration_cast<std::chrono::milliseconds>(stop - start);
+    uint64_t nodes = Game::instance().get_total_nodes();
+    UCIInterface::uci_response(std::to_string(nodes) + " nodes searched.");
+    UCIInterface::uci_response("Time taken: " + std::to_string(duration.count()) + " ms.");
+    int64_t nps = (1000 * nodes / std::max<int64_t>(duration.count(), 1));
+    UCIInterface::uci_response("Nodes per second: " + std::to_string(nps));
+}
+
+void UCIInterface::process_setoption_command(std::string command) {
+    // Example: "name Threads value 4"
+    std::vector<std::string> parts = split(command, ' ');
+    if (parts.size() < 4 || parts[0] != "name" || parts[2] != "value") {
+        UCIInterface::uci_response("A setoption command must have the structure setoption name <id> value <x>");
+        return;
+    }
+    if (parts[1] == "Threads") {
+        std::optional<int> threads = try_process_int(parts[3]);
+        if (threads) {
+            Game::instance().set_threads(std::clamp(threads.value(), 1, MAX_THREADS));
+            if (debug_mode)
+                UCIInterface::uci_response("Threads set to " + std::to_string(Game::instance().get_threads()));
+        }
+    } else if (parts[1] == "Hash") {
+        std::optional<int> size_MB = try_process_int(parts[3]);
+        if (size_MB) {
+            Game::instance().set_hash_size(std::clamp(size_MB.value(), 1, MAX_HASH_MB));
+            if (debug_mode)
+                UCIInterface::uci_response("Hash set to " + std::to_string(Game::instance().get_hash_size()) + " MB");
+        }
+#ifdef USE_NNUE
+    } else if (parts[1] == "UseNNUE") {
+        nnue::set_use(parts[3] == "true");
+        if (parts[3] == "true" && !nnue::loaded)
+            UCIInterface::uci_response("info string No network loaded, using the classical eval. Set EvalFile to load one.");
+    } else if (parts[1] == "EvalFile") {
+        if (nnue::load(parts[3]))
+            UCIInterface::uci_response("info string Network loaded from " + parts[3]);
+        else
+            UCIInterface::uci_response("info string Could not load a network from " + parts[3]);
+#endif
+    } else {
+        UCIInterface::uci_response("Unknown option: " + parts[1]);
+    }
+}
+
 void UCIInterface::process_fen_command(std::string command) {
     UCIInterface::uci_response("Processing FEN command: " + command);
     bool success = Game::instance().set_fen(command);
@@ -277,7 +447,10 @@ void UCIInterface::process_fen_command(std::string command) {
     UCIInterface::uci_response("FEN command processed.");
 }
 
-void UCIInterface::uci_response(std::string response) { std::cout << response << std::endl; }
+void UCIInterface::uci_response(std::string response) {
+    std::lock_guard<std::mutex> lock(output_mutex);
+    std::cout << response << std::endl;
+}
 std::vector<std::string> UCIInterface::split(std::string full, char del) {
     std::stringstream ss(full);
     std::string temp;
@@ -321,6 +494,7 @@ void UCIInterface::process_self_command(std::string command) {
     std::string comm = fen + " moves";
     for (int i = 0; i < nummoves; i++) {
         process_go_command("wtime 1000 btime 1000 winc 0 binc 0");
+        wait_for_search();
         Move bestmove = Game::instance().get_bestmove();
         if (bestmove.is_valid())
             comm.append(" " + bestmove.toString());
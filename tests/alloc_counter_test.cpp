@@ -0,0 +1,43 @@
+// Copyright 2025 Filip Agert
+#include <alloc_counter.h>
+#include <cstdint>
+#include <game.h>
+#include <gtest/gtest.h>
+#include <memory>
+#include <optional>
+#include <thread>
+#include <vector>
+
+TEST(AllocCounterTest, countsOwnThread) {
+    uint64_t before = alloc_counter::thread_allocations();
+    std::unique_ptr<int> p = std::make_unique<int>(1);
+    std::vector<int> v(10);
+    ASSERT_EQ(alloc_counter::thread_allocations() - before, 2);
+    uint64_t other_allocations = 0;
+    std::thread other([&other_allocations] {
+        uint64_t other_before = alloc_counter::thread_allocations();
+        std::vector<int> w(10);
+        other_allocations = alloc_counter::thread_allocations() - other_before;
+    });
+    other.join();
+    ASSERT_EQ(other_allocations, 1);
+}
+TEST(AllocCounterTest, searchDoesNotAllocate) {
+    Game &game = Game::instance();
+    game.set_fen("r3k2r/p1ppqpb1/bn2pnp1/3PN3/1p2P3/2N2Q1p/PPPBBPPP/R3K2R w KQkq - 1 1");
+    game.start_thinking(search_limits{.depth = 6});
+    std::optional<InfoMsg> last;
+    while (std::optional<InfoMsg> msg = game.info_queue.pop())
+        last = msg;
+    ASSERT_TRUE(last);
+    ASSERT_EQ(last.value().depth, 6);
+    ASSERT_EQ(last.value().allocations, 0);
+}
+TEST(SearchStackTest, depthBeyondMaxPly) {
+    Game &game = Game::instance();
+    game.set_fen("8/8/8/4k3/8/8/8/4K3 w - - 0 1");
+    game.start_thinking(search_limits{.depth = 90});  // Iterations stop at MAX_PLY - 1, within the search stack.
+    while (game.info_queue.pop()) {
+    }
+    ASSERT_TRUE(game.get_bestmove().is_valid());
+}
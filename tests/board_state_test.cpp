@@ -1,11 +1,14 @@
 // board_test.cpp
 #include "constants.h"
 #include <board.h>
+#include <eval.h>
 #include <gtest/gtest.h>
 #include <integer_representation.h>
 #include <move.h>
 #include <notation_interface.h>
 #include <string>
+#include <tables.h>
+#include "tree_walk.h"
 
 using namespace pieces;
 TEST(BoardTest, doUndoMove) {
@@ -261,3 +264,125 @@ TEST(BoardTest, enPassantSquare) {
     auto info3 = board.do_move_no_flag<true>(move);
     ASSERT_FALSE(board.get_en_passant());
 }
+TEST(BoardTest, doUndoNullMove) {
+    Board board;
+    board.read_fen("4k3/8/8/3pP3/8/8/8/4K3 w - d6 0 1");
+    Board before = board;
+    uint64_t hash = board.get_hash();
+    restore_move_info info = board.do_null_move();
+    ASSERT_EQ(board.get_turn_color(), black);
+    ASSERT_FALSE(board.get_en_passant());
+    ASSERT_NE(board.get_hash(), hash);
+    ASSERT_EQ(board.get_hash(), ZobroistHasher::get().hash_board(board));
+    board.undo_null_move(info);
+    ASSERT_EQ(board.get_hash(), hash);
+    ASSERT_TRUE(board == before);
+    ASSERT_EQ(board.get_en_passant_square(), NotationInterface::idx_from_string("d6"));
+}
+const auto check_psqt_sums = [](Board &board, auto) {
+    Board fresh;
+    fresh.read_fen(board.fen_from_state());
+    ASSERT_EQ(board.get_mg_score(), fresh.get_mg_score()) << board.fen_from_state();
+    ASSERT_EQ(board.get_eg_score(), fresh.get_eg_score()) << board.fen_from_state();
+    ASSERT_EQ(board.get_phase(), fresh.get_phase()) << board.fen_from_state();
+    ASSERT_EQ(board.get_pawn_hash(), fresh.get_pawn_hash()) << board.fen_from_state();
+};
+TEST(BoardTest, incrementalPsqtSums) {
+    Board board;
+    board.read_fen("rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1");
+    ASSERT_EQ(board.get_mg_score(), 0);  // Symmetric position.
+    ASSERT_EQ(board.get_eg_score(), 0);
+    ASSERT_EQ(board.get_phase(), PieceValue::max_phase);
+    // Castling, captures, en passant and promotions.
+    board.read_fen("r3k2r/pPppqpb1/bn2pnp1/3PN3/1p2P3/2N2Q1p/PPPBBPPP/R3K2R w KQkq - 1 1");
+    for_each_node(board, 2, check_psqt_sums);
+    board.read_fen("8/2p5/3p4/KP5r/1R3p1k/8/4P1P1/8 w - - 0 1");
+    for_each_node(board, 3, check_psqt_sums);
+}
+TEST(BoardTest, pawnHashTable) {
+    Board board;
+    board.read_fen("r3k2r/p1ppqpb1/bn2pnp1/3PN3/1p2P3/2N2Q1p/PPPBBPPP/R3K2R w KQkq - 1 1");
+    pawn_table pawns;
+    int eval = EvalState::eval(board);
+    ASSERT_EQ(EvalState::eval(board, &pawns), eval);
+    ASSERT_EQ(EvalState::eval(board, &pawns), eval);
+    ASSERT_EQ(pawns.probes, 2);
+    ASSERT_EQ(pawns.hits, 1);
+
+    // A knight move keeps the pawn structure, a pawn capture changes it.
+    uint64_t pawn_hash = board.get_pawn_hash();
+    Move knight_move("e5d3");
+    board.do_move_no_flag<true>(knight_move);
+    ASSERT_EQ(board.get_pawn_hash(), pawn_hash);
+    ASSERT_EQ(EvalState::eval(board, &pawns), EvalState::eval(board));
+    ASSERT_EQ(pawns.hits, 2);
+    Move pawn_capture("b4c3");
+    board.do_move_no_flag<false>(pawn_capture);
+    ASSERT_NE(board.get_pawn_hash(), pawn_hash);
+    ASSERT_EQ(board.get_pawn_hash(), ZobroistHasher::get().hash_pawns(board));
+    ASSERT_EQ(EvalState::eval(board, &pawns), EvalState::eval(board));
+    ASSERT_EQ(pawns.hits, 2);
+    ASSERT_EQ(EvalState::eval_pawns(board).semi_open_files[false], 0b00000010);  // b-file.
+
+    board.read_fen("4k3/8/8/3P4/8/8/PP6/4K3 w - - 0 1");
+    pawn_entry entry = EvalState::eval_pawns(board);
+    ASSERT_EQ(entry.passed[true], (board.get_piece_bb<pawn, true>()));
+    ASSERT_EQ(entry.passed[false], 0);
+    ASSERT_EQ(entry.semi_open_files[true], 0b11110100);
+    ASSERT_EQ(entry.semi_open_files[false], 0b11111111);
+}
+TEST(BoardTest, evalCache) {
+    Board board;
+    board.read_fen("r3k2r/p1ppqpb1/bn2pnp1/3PN3/1p2P3/2N2Q1p/PPPBBPPP/R3K2R w KQkq - 1 1");
+    eval_cache evals;
+    int eval = EvalState::eval(board);
+    ASSERT_EQ(EvalState::cached_eval(board, evals), eval);
+    ASSERT_EQ(EvalState::cached_eval(board, evals), eval);
+    ASSERT_EQ(evals.probes, 2);
+    ASSERT_EQ(evals.hits, 1);
+
+    // The side to move is part of the key, the same placement after a null move is a new entry.
+    restore_move_info info = board.do_null_move();
+    ASSERT_EQ(EvalState::cached_eval(board, evals), -eval);
+    ASSERT_EQ(evals.hits, 1);
+    board.undo_null_move(info);
+    ASSERT_EQ(EvalState::cached_eval(board, evals), eval);
+    ASSERT_EQ(evals.hits, 2);
+
+    // Positions at the fifty move limit are draws whatever the cache holds, and are not stored.
+    board.read_fen("r3k2r/p1ppqpb1/bn2pnp1/3PN3/1p2P3/2N2Q1p/PPPBBPPP/R3K2R w KQkq - 100 60");
+    ASSERT_EQ(EvalState::cached_eval(board, evals), 0);
+    ASSERT_EQ(evals.probes, 4);
+    evals.clear();
+    board.read_fen("r3k2r/p1ppqpb1/bn2pnp1/3PN3/1p2P3/2N2Q1p/PPPBBPPP/R3K2R w KQkq - 1 1");
+    ASSERT_EQ(EvalState::cached_eval(board, evals), eval);
+    ASSERT_EQ(evals.hits, 2);
+}
+// Every move from board is taken back by restoring its snapshot.
+const auto check_restore = [](Board &board, auto is_white) {
+    const Board before = board;
+    const position_snapshot snapshot = board.snapshot();
+    std::array<Move, max_legal_moves> moves;
+    size_t num_moves = board.get_moves<normal_search, is_white>(moves);
+    for (size_t i = 0; i < num_moves; i++) {
+        board.do_move<is_white>(moves[i]);
+        board.restore<is_white>(snapshot, moves[i]);
+        ASSERT_TRUE(board == before) << before.fen_from_state() << " " << moves[i].toString();
+        ASSERT_TRUE(board.board_BB_match());
+        ASSERT_EQ(board.get_hash(), before.get_hash());
+        ASSERT_EQ(board.get_pawn_hash(), before.get_pawn_hash());
+        ASSERT_EQ(board.get_mg_score(), before.get_mg_score());
+        ASSERT_EQ(board.get_eg_score(), before.get_eg_score());
+        ASSERT_EQ(board.get_phase(), before.get_phase());
+    }
+};
+TEST(BoardTest, snapshotRestore) {
+    // Castling, en passant and promotions with and without capture.
+    Board board;
+    board.read_fen("r3k2r/p1ppqpb1/bn2pnp1/3PN3/1p2P3/2N2Q1p/PPPBBPPP/R3K2R w KQkq - 1 1");
+    for_each_node(board, 2, check_restore);
+    board.read_fen("r3k2r/pPppqpb1/bn2pnp1/3PN3/1p2P3/2N2Q1p/PPPBBPPP/R3K2R w KQkq - 1 1");
+    for_each_node(board, 2, check_restore);
+    board.read_fen("8/8/8/K2pP2r/8/8/8/7k w - d6 0 2");
+    for_each_node(board, 2, check_restore);
+}
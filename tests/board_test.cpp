@@ -293,3 +293,36 @@ TEST(BoardTest, clear_board_empty) {
         ASSERT_EQ(b.get_piece_at(i).get_type(), none);
     }
 }
+TEST(BoardTest, see) {
+    Board board;
+    // Pawn takes undefended pawn.
+    board.read_fen("4k3/8/8/3p4/4P3/8/8/4K3 w - - 0 1");
+    ASSERT_TRUE(board.see(Move("e4d5"), 0));
+    ASSERT_TRUE(board.see(Move("e4d5"), 100));
+    ASSERT_FALSE(board.see(Move("e4d5"), 101));
+    // Queen takes pawn defended by pawn.
+    board.read_fen("4k3/8/2p5/3p4/8/8/8/3QK3 w - - 0 1");
+    ASSERT_FALSE(board.see(Move("d1d5"), 0));
+    ASSERT_TRUE(board.see(Move("d1d5"), -800));
+    ASSERT_FALSE(board.see(Move("d1d5"), -799));
+    // Quiet move to a square attacked by a pawn.
+    board.read_fen("4k3/8/8/4p3/8/8/8/3QK3 w - - 0 1");
+    ASSERT_FALSE(board.see(Move("d1d4"), 0));
+    ASSERT_TRUE(board.see(Move("d1d3"), 0));
+    // Rook takes defended pawn, the rook behind it recaptures through x-ray.
+    board.read_fen("4k3/3r4/8/3p4/8/8/3R4/3RK3 w - - 0 1");
+    ASSERT_TRUE(board.see(Move("d2d5"), 100));
+    // A second black rook behind wins the exchange.
+    board.read_fen("3rk3/3r4/8/3p4/8/8/3R4/3RK3 w - - 0 1");
+    ASSERT_FALSE(board.see(Move("d2d5"), 0));
+    ASSERT_TRUE(board.see(Move("d2d5"), -400));
+    // The king can only recapture an undefended piece.
+    board.read_fen("8/8/4k3/3p4/8/8/3R4/4K3 w - - 0 1");
+    ASSERT_FALSE(board.see(Move("d2d5"), 0));
+    board.read_fen("8/8/4k3/3p4/8/8/3R4/3RK3 w - - 0 1");
+    ASSERT_TRUE(board.see(Move("d2d5"), 100));
+    // En passant removes the captured pawn.
+    board.read_fen("4k3/8/8/3pP3/8/8/8/4K3 w - d6 0 1");
+    Move ep = Move(NotationInterface::idx_from_string("e5"), NotationInterface::idx_from_string("d6"), moveflag::MOVEFLAG_pawn_ep_capture);
+    ASSERT_TRUE(board.see(ep, 100));
+}
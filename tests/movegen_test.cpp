@@ -10,9 +10,11 @@
 #include <move.h>
 #include <movegen.h>
 #include <movegen_benchmark.h>
+#include <movepicker.h>
 #include <notation_interface.h>
 #include <string>
 #include <vector>
+#include "tree_walk.h"
 using namespace BitBoard;
 using namespace movegen;
 using namespace dirs;
@@ -38,6 +40,14 @@ TEST(magic_test, rookmagic) {
         }
     }
 }
+#ifdef USE_PEXT
+TEST(magic_test, pext_constant_evaluation) {
+    constexpr uint64_t occ = 0x0123456789abcdefULL;
+    constexpr uint64_t compile_time = pext(occ, rook_occupancy_table[27]);
+    volatile uint64_t runtime_occ = occ;  // Keeps the compiler from folding the instruction.
+    ASSERT_EQ(pext(runtime_occ, rook_occupancy_table[27]), compile_time);
+}
+#endif
 TEST(magic_test, rookxraymagic) {
 
     for (int i = 0; i < 64; i++) {
@@ -147,6 +157,109 @@ TEST(perft, kiwipete) {
         ASSERT_EQ(expected, num_moves);
     }
 }
+TEST(perft, kiwipete_parallel) {
+    std::string starting_fen = "r3k2r/p1ppqpb1/bn2pnp1/3PN3/1p2P3/2N2Q1p/PPPBBPPP/R3K2R w KQkq - 1 1";
+    Board board;
+    board.read_fen(starting_fen);
+    ASSERT_EQ(movegen_benchmark::gen_num_moves_parallel(board, 2, 4), 2039);
+    ASSERT_EQ(movegen_benchmark::gen_num_moves_parallel(board, 4, 4), 4085603);
+    ASSERT_EQ(movegen_benchmark::gen_num_moves_parallel(board, 4, 4, 16), 4085603);
+    ASSERT_EQ(movegen_benchmark::gen_num_moves_parallel(board, 5, 4, 16), 193690690);
+}
+TEST(perft, startpos_hashed) {
+    Board board;
+    board.read_fen(NotationInterface::starting_FEN());
+    ASSERT_EQ(movegen_benchmark::gen_num_moves_parallel(board, 6, 2, 16), 119060324);
+}
+TEST(perft, count_moves_matches_get_moves) {
+    std::vector<std::string> fens = {"r3k2r/p1ppqpb1/bn2pnp1/3PN3/1p2P3/2N2Q1p/PPPBBPPP/R3K2R w KQkq - 1 1",
+                                     "8/2p5/3p4/KP5r/1R3p1k/8/4P1P1/8 w - - 0 1",
+                                     "r2q1rk1/pP1p2pp/Q4n2/bbp1p3/Np6/1B3NBn/pPPP1PPP/R3K2R b KQ - 0 1",
+                                     "n1n5/PPPk4/8/8/8/8/4Kppp/5N1N b - - 0 1",
+                                     "8/8/8/K2pP2r/8/8/8/7k w - d6 0 2"};
+    for (const std::string &fen : fens) {
+        Board board;
+        board.read_fen(fen);
+        for_each_node(board, 2, [](Board &node, auto is_white) {
+            std::array<Move, max_legal_moves> moves;
+            size_t num_moves = node.get_moves<normal_search, is_white>(moves);
+            ASSERT_EQ(node.count_moves<is_white>(), num_moves) << node.fen_from_state();
+        });
+    }
+}
+const auto check_quiet_checks = [](Board &board, auto is_white) {
+    std::array<Move, max_legal_moves> moves;
+    size_t num_checks = board.get_moves<quiet_check_search, is_white>(moves);
+    std::vector<Move> checks(moves.begin(), moves.begin() + num_checks);
+    std::vector<Move> expected;
+    size_t num_quiets = board.get_moves<quiet_search, is_white>(moves);
+    for (size_t i = 0; i < num_quiets; i++) {
+        if (moves[i].flag == moveflag::MOVEFLAG_short_castling || moves[i].flag == moveflag::MOVEFLAG_long_castling)
+            continue;  // Checks by castling are not generated.
+        restore_move_info info = board.do_move<is_white>(moves[i]);
+        if (board.king_checked<!is_white>())
+            expected.push_back(moves[i]);
+        board.undo_move<is_white>(info, moves[i]);
+    }
+    ASSERT_EQ(checks.size(), expected.size()) << board.fen_from_state();
+    for (Move move : expected)
+        ASSERT_EQ(std::count(checks.begin(), checks.end(), move), 1) << board.fen_from_state() << " " << move.toString();
+};
+TEST(Movegentest, quiet_checks) {
+    std::vector<std::string> fens = {"r3k2r/p1ppqpb1/bn2pnp1/3PN3/1p2P3/2N2Q1p/PPPBBPPP/R3K2R w KQkq - 1 1",
+                                     "8/2p5/3p4/KP5r/1R3p1k/8/4P1P1/8 w - - 0 1",
+                                     "r2q1rk1/pP1p2pp/Q4n2/bbp1p3/Np6/1B3NBn/pPPP1PPP/R3K2R b KQ - 0 1",
+                                     "4k3/8/8/8/4N3/8/8/4R1K1 w - - 0 1",   // Discovered checks by a knight.
+                                     "7k/8/8/8/3P4/8/1B6/6K1 w - - 0 1"};  // Discovered check by a pawn push.
+    for (const std::string &fen : fens) {
+        Board board;
+        board.read_fen(fen);
+        for_each_node(board, 2, check_quiet_checks);
+    }
+}
+TEST(MovePicker, yieldsAllMovesInStages) {
+    std::vector<std::string> fens = {"r3k2r/p1ppqpb1/bn2pnp1/3PN3/1p2P3/2N2Q1p/PPPBBPPP/R3K2R w KQkq - 1 1",
+                                     "r2q1rk1/pP1p2pp/Q4n2/bbp1p3/Np6/1B3NBn/pPPP1PPP/R3K2R b KQ - 0 1",
+                                     "8/8/8/K2pP2r/8/8/8/7k w - d6 0 2"};
+    for (const std::string &fen : fens) {
+        Board board;
+        board.read_fen(fen);
+        bool white = board.get_turn_color() == pieces::white;
+        std::array<Move, max_legal_moves> expected;
+        size_t num_moves = white ? board.get_moves<normal_search, true>(expected) : board.get_moves<normal_search, false>(expected);
+        Move tt_move = expected[num_moves - 1];
+
+        std::array<Move, max_legal_moves> storage;
+        std::vector<Move> picked;
+        Move move;
+        if (white) {
+            MovePicker<true> picker(board, storage, tt_move);
+            while (picker.next(move))
+                picked.push_back(move);
+        } else {
+            MovePicker<false> picker(board, storage, tt_move);
+            while (picker.next(move))
+                picked.push_back(move);
+        }
+        ASSERT_EQ(picked.size(), num_moves) << fen;
+        ASSERT_EQ(picked[0], tt_move);
+        for (size_t i = 0; i < num_moves; i++)
+            ASSERT_EQ(std::count(picked.begin(), picked.end(), expected[i]), 1) << fen << " " << expected[i].toString();
+
+        // Captures and promotions come before the first quiet move, except those losing material,
+        // which come after the last one.
+        bool quiet_seen = false;
+        bool losing_seen = false;
+        for (size_t i = 1; i < picked.size(); i++) {
+            bool tactical = !board.is_square_empty(picked[i].target) || picked[i].is_promotion() || picked[i].flag == moveflag::MOVEFLAG_pawn_ep_capture;
+            bool losing = tactical && !board.see(picked[i], 0);
+            ASSERT_FALSE(tactical && !losing && quiet_seen) << fen << " " << picked[i].toString();
+            ASSERT_FALSE(!tactical && losing_seen) << fen << " " << picked[i].toString();
+            quiet_seen |= !tactical;
+            losing_seen |= losing;
+        }
+    }
+}
 TEST(perft, p3) {
     std::vector<int> moves = {14, 191, 2812, 43238, 674624};
     std::string starting_fen = "8/2p5/3p4/KP5r/1R3p1k/8/4P1P1/8 w - - 0 1";
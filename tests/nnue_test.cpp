@@ -0,0 +1,83 @@
+// Copyright 2025 Filip Agert
+#include <array>
+#include <board.h>
+#include <cstdint>
+#include <eval.h>
+#include <filesystem>
+#include <fstream>
+#include <gtest/gtest.h>
+#include <nnue.h>
+#include <random>
+#include <string>
+#include <vector>
+#include "tree_walk.h"
+// The network eval is only built with make nnue=1.
+#ifdef USE_NNUE
+
+/**
+ * @brief Writes a network of small random weights and loads it. The network state is global, so
+ * it is unloaded again after each test.
+ */
+class NNUETest : public ::testing::Test {
+ protected:
+    std::string path = (std::filesystem::temp_directory_path() / "nnue_test.bin").string();
+
+    void SetUp() override {
+        std::mt19937 rng(42);
+        std::uniform_int_distribution<int> weight(-64, 64);
+        size_t num_values = nnue::num_features * nnue::hidden + nnue::hidden + 2 * nnue::hidden + 1;
+        std::vector<int16_t> values(num_values);
+        for (int16_t &v : values)
+            v = static_cast<int16_t>(weight(rng));
+        std::ofstream file(path, std::ios::binary);
+        file.write(reinterpret_cast<const char *>(values.data()), values.size() * sizeof(int16_t));
+        file.close();
+        ASSERT_TRUE(nnue::load(path));
+        ASSERT_TRUE(nnue::enabled);
+    }
+    void TearDown() override {
+        nnue::loaded = false;
+        nnue::set_use(true);
+        std::filesystem::remove(path);
+    }
+};
+
+const auto check_accumulator = [](Board &board, auto is_white) {
+    Board fresh = board;
+    fresh.refresh_accumulator();
+    ASSERT_EQ(board.get_accumulator().values, fresh.get_accumulator().values) << board.fen_from_state();
+    ASSERT_EQ(nnue::evaluate(board.get_accumulator(), is_white), nnue::evaluate_scalar(board.get_accumulator(), is_white));
+};
+TEST_F(NNUETest, incrementalAccumulatorMatchesRefresh) {
+    Board board;
+    board.read_fen("r3k2r/pPppqpb1/bn2pnp1/3PN3/1p2P3/2N2Q1p/PPPBBPPP/R3K2R w KQkq - 1 1");
+    for_each_node(board, 2, check_accumulator);
+    board.read_fen("8/8/8/K2pP2r/8/8/8/7k w - d6 0 2");
+    for_each_node(board, 3, check_accumulator);
+}
+TEST_F(NNUETest, evalIsColorSymmetric) {
+    // The same position with colors swapped, from the side to move, reads the same inputs.
+    Board board;
+    board.read_fen("rnbqkbnr/pppppppp/8/8/4P3/8/PPPP1PPP/RNBQKBNR b KQkq - 0 1");
+    Board mirrored;
+    mirrored.read_fen("rnbqkbnr/pppp1ppp/8/4p3/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1");
+    ASSERT_EQ(EvalState::eval(board), EvalState::eval(mirrored));
+    ASSERT_EQ(EvalState::eval(board), nnue::evaluate(board.get_accumulator(), false));
+}
+TEST_F(NNUETest, useOptionAndBadFiles) {
+    Board board;
+    board.read_fen("rnbqkbnr/pppppppp/8/8/4P3/8/PPPP1PPP/RNBQKBNR b KQkq - 0 1");
+    int network_eval = EvalState::eval(board);
+    nnue::set_use(false);
+    ASSERT_FALSE(nnue::enabled);
+    int classical_eval = EvalState::eval(board);
+    nnue::set_use(true);
+    ASSERT_EQ(EvalState::eval(board), network_eval);
+    ASSERT_NE(network_eval, classical_eval);  // Holds for this random network.
+
+    ASSERT_FALSE(nnue::load(path + ".missing"));
+    std::ofstream(path, std::ios::binary | std::ios::trunc) << "too short";
+    ASSERT_FALSE(nnue::load(path));
+    ASSERT_TRUE(nnue::enabled);  // The loaded network is kept.
+}
+#endif
@@ -0,0 +1,62 @@
+// Copyright 2025 Filip Agert
+#include <chrono>
+#include <cstdint>
+#include <game.h>
+#include <gtest/gtest.h>
+#include <optional>
+#include <spsc_queue.h>
+#include <string>
+#include <thread>
+
+TEST(SPSCQueueTest, fifoAndCapacity) {
+    spsc_queue<std::string, 4> queue;
+    ASSERT_TRUE(queue.empty());
+    ASSERT_FALSE(queue.pop());
+    for (int i = 0; i < 4; i++)
+        ASSERT_TRUE(queue.push(std::to_string(i)));
+    ASSERT_FALSE(queue.push("full"));
+    ASSERT_EQ(queue.pop().value(), "0");
+    ASSERT_TRUE(queue.push("4"));  // Wraps around.
+    for (int i = 1; i <= 4; i++)
+        ASSERT_EQ(queue.pop().value(), std::to_string(i));
+    ASSERT_TRUE(queue.empty());
+}
+TEST(SPSCQueueTest, twoThreadsKeepOrder) {
+    constexpr uint64_t count = 100000;
+    spsc_queue<uint64_t, 64> queue;
+    std::thread producer([&queue] {
+        for (uint64_t i = 0; i < count; i++)
+            while (!queue.push(i))
+                std::this_thread::yield();
+    });
+    uint64_t expected = 0;
+    while (expected < count) {
+        std::optional<uint64_t> value = queue.pop();
+        if (!value) {
+            std::this_thread::yield();
+            continue;
+        }
+        ASSERT_EQ(value.value(), expected);
+        expected++;
+    }
+    producer.join();
+    ASSERT_TRUE(queue.empty());
+}
+TEST(SPSCQueueTest, lastIterationInfoWaitsForRoom) {
+    Game &game = Game::instance();
+    game.set_fen("8/8/8/4k3/8/8/8/4K3 w - - 0 1");
+    while (game.info_queue.push(InfoMsg())) {  // The search finds the queue full.
+    }
+    std::thread printer([&game] {
+        std::this_thread::sleep_for(std::chrono::milliseconds(INFO_FINAL_WAIT_MS / 5));
+        for (int i = 0; i < INFO_QUEUE_SIZE; i++)  // Only takes the filler, the search's messages stay for the test.
+            game.info_queue.pop();
+    });
+    game.start_thinking(search_limits{.depth = 4});
+    printer.join();
+    std::optional<InfoMsg> last;
+    while (std::optional<InfoMsg> msg = game.info_queue.pop())
+        last = msg;
+    ASSERT_TRUE(last);
+    ASSERT_EQ(last.value().depth, 4);
+}
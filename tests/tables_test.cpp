@@ -6,6 +6,7 @@
 #include <moveorder.h>
 #include <notation_interface.h>
 #include <tables.h>
+#include "tree_walk.h"
 
 TEST(ZobroistTest, rand) {
     int numhi = 0;
@@ -58,6 +59,59 @@ TEST(TransTest, optionalReturn) {
     tab->store(hash, Move{2, 9}, 0, transposition_entry::exact, 0);
     ASSERT_TRUE(tab->get(hash));
 }
+TEST(TransTest, bucketKeepsDeepEntries) {
+    std::unique_ptr<transposition_table> tab = std::make_unique<transposition_table>(1);
+    uint64_t stride = tab->get_num_buckets();  // hashes base + k * stride share a bucket.
+    uint64_t base = 12345;
+    for (uint64_t k = 1; k <= transposition_bucket::num_slots; k++)
+        tab->store(base + k * stride, Move{2, 9}, 0, transposition_entry::exact, 10 + k);
+    for (uint64_t k = 1; k <= transposition_bucket::num_slots; k++)
+        ASSERT_TRUE(tab->get(base + k * stride));
+
+    // Full bucket: a new entry replaces the shallowest one.
+    tab->store(base, Move{2, 9}, 0, transposition_entry::exact, 1);
+    ASSERT_TRUE(tab->get(base));
+    ASSERT_FALSE(tab->get(base + stride));
+    for (uint64_t k = 2; k <= transposition_bucket::num_slots; k++)
+        ASSERT_TRUE(tab->get(base + k * stride));
+
+    // Storing the same position reuses its slot.
+    tab->store(base + 2 * stride, Move{2, 9}, 7, transposition_entry::lb, 3);
+    ASSERT_EQ(tab->get(base + 2 * stride).value().eval, 7);
+    ASSERT_TRUE(tab->get(base));
+
+    // Entries from an old search count as shallower.
+    tab->new_search();
+    tab->store(base + 9 * stride, Move{2, 9}, 0, transposition_entry::exact, 2);
+    tab->store(base + 10 * stride, Move{2, 9}, 0, transposition_entry::exact, 2);
+    ASSERT_TRUE(tab->get(base + 9 * stride));
+    ASSERT_TRUE(tab->get(base + 10 * stride));
+}
+TEST(TransTest, resizeAndLoadFactor) {
+    std::unique_ptr<transposition_table> tab = std::make_unique<transposition_table>(1);
+    ASSERT_EQ(tab->get_size_MB(), 1);
+    ASSERT_EQ(tab->load_factor(), 0);
+    for (uint64_t i = 0; i < tab->get_num_buckets() * transposition_bucket::num_slots; i++)
+        tab->store(ZobroistHasher::get().rand_uint64_t(), Move{2, 9}, 0, transposition_entry::exact, 5);
+    int filled = tab->load_factor();
+    ASSERT_GT(filled, 500);
+    ASSERT_LE(filled, 1000);
+    tab->new_search();  // hashfull only counts the current search.
+    ASSERT_EQ(tab->load_factor(), 0);
+
+    tab->resize(4);
+    ASSERT_EQ(tab->get_size_MB(), 4);
+    ASSERT_EQ(tab->load_factor(), 0);
+}
+TEST(TransTest, entryPackRoundTrip) {
+    transposition_entry entry = {42, transposition_entry::ub, 17, -29999, Move(12, 28, static_cast<Flag_t>(1)), 63};
+    transposition_entry unpacked = transposition_entry::unpack(42, entry.pack());
+    ASSERT_EQ(unpacked.nodetype, entry.nodetype);
+    ASSERT_EQ(unpacked.depth, entry.depth);
+    ASSERT_EQ(unpacked.eval, entry.eval);
+    ASSERT_EQ(unpacked.bestmove, entry.bestmove);
+    ASSERT_EQ(unpacked.age, entry.age);
+}
 TEST(TransTest, moveOrderTest) {
     Board state;
     state.read_fen(NotationInterface::starting_FEN());
@@ -73,6 +127,37 @@ TEST(TransTest, moveOrderTest) {
         ASSERT_EQ(moves[i].source, moves[i].target);
     }
 }
+TEST(TransTest, partialMoveSortIsStable) {
+    std::array<Move, max_legal_moves> moves;
+    std::array<int, max_legal_moves> scores;
+    std::array<int, 6> input = {3, -40000, 7, 3, 50000, -1};
+    for (size_t i = 0; i < input.size(); i++) {
+        moves[i] = Move(i, 63 - i, static_cast<Flag_t>(i));
+        scores[i] = input[i];
+    }
+    ASSERT_EQ(MoveOrder::unpack(MoveOrder::pack(moves[4], scores[4])), moves[4]);
+    MoveOrder::partial_move_sort(moves, scores, input.size(), false);
+    std::array<int, 6> expected_src = {4, 2, 0, 3, 5, 1};
+    for (size_t i = 0; i < input.size(); i++) {
+        ASSERT_EQ(moves[i].source, expected_src[i]);
+        ASSERT_EQ(scores[i], input[expected_src[i]]);
+    }
+    MoveOrder::partial_move_sort(moves, scores, 1, input.size(), true);
+    std::array<int, 6> ascending_src = {4, 1, 5, 0, 3, 2};
+    for (size_t i = 0; i < input.size(); i++)
+        ASSERT_EQ(moves[i].source, ascending_src[i]);
+}
+TEST(TransTest, historyStaysInRange) {
+    int entry = 0;
+    for (int i = 0; i < 1000; i++)
+        MoveOrder::update_history(entry, MoveOrder::max_history / 4);
+    ASSERT_LE(entry, MoveOrder::max_history);
+    ASSERT_GT(entry, MoveOrder::max_history * 9 / 10);
+    for (int i = 0; i < 1000; i++)
+        MoveOrder::update_history(entry, -MoveOrder::max_history);
+    ASSERT_GE(entry, -MoveOrder::max_history);
+    ASSERT_LT(entry, 0);
+}
 TEST(ZobroistTest, TranspositionIdentity) {
     // We will establish the position after 1. e4 e5 2. Nf3 Nc6 3. Nc3 Nf6
 
@@ -213,3 +298,13 @@ TEST(ZobristTest, MoveUndoIntegrity) {
     // ASSERTION 2: Hash must return to the original value
     ASSERT_EQ(hash_A, hash_C) << "Hash failed to revert after undo_move.";
 }
+TEST(ZobristTest, IncrementalMatchesFull) {
+    // Kiwipete (castling, captures of rooks, ep) and a promotion heavy position.
+    std::vector<std::string> fens = {"r3k2r/p1ppqpb1/bn2pnp1/3PN3/1p2P3/2N2Q1p/PPPBBPPP/R3K2R w KQkq - 0 1",
+                                     "n1n5/PPPk4/8/8/8/8/4Kppp/5N1N b - - 0 1", "rnbqkbnr/ppp1p1pp/8/3pPp2/8/8/PPPP1PPP/RNBQKBNR w KQkq f6 0 3"};
+    for (std::string fen : fens) {
+        Board board;
+        board.read_fen(fen);
+        for_each_node(board, 3, [](Board &node, auto) { ASSERT_EQ(node.get_hash(), ZobroistHasher::get().hash_board(node)) << node.fen_from_state(); });
+    }
+}
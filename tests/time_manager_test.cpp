@@ -50,3 +50,42 @@ TEST(TimeManagerTest, thread_stop_test) {
     int durms = duration.count();
     ASSERT_LE(durms, 1);
 }
+TEST(TimeManagerTest, movetime_is_used_fully) {
+    search_limits limits;
+    limits.movetime = 60;
+    TimeManager manager = TimeManager(limits, 10, 20, true);  // 50 ms.
+    manager.start_time_management();
+    std::this_thread::sleep_for(30ms);  // Past half the time a clock search stops deepening, a fixed move time does not.
+    ASSERT_TRUE(manager.get_should_start_new_iteration());
+    ASSERT_FALSE(manager.get_should_stop());
+    std::this_thread::sleep_for(40ms);
+    ASSERT_TRUE(manager.get_should_stop());
+    manager.stop_and_join();
+}
+TEST(TimeManagerTest, ponder_counts_from_ponderhit) {
+    search_limits limits;
+    limits.clock = time_control(200, 200, 0, 0);
+    limits.ponder = true;
+    TimeManager manager = TimeManager(limits, 0, 10, true);  // 20 ms after ponderhit.
+    manager.start_time_management();
+    std::this_thread::sleep_for(40ms);
+    ASSERT_FALSE(manager.get_should_stop());
+    manager.ponderhit();
+    std::this_thread::sleep_for(5ms);
+    ASSERT_FALSE(manager.get_should_stop());
+    std::this_thread::sleep_for(30ms);
+    ASSERT_TRUE(manager.get_should_stop());
+    manager.stop_and_join();
+}
+TEST(TimeManagerTest, no_clock_is_infinite) {
+    search_limits limits;
+    limits.depth = 5;
+    TimeManager manager = TimeManager(limits, 10, 20, true);
+    manager.start_time_management();
+    std::this_thread::sleep_for(20ms);
+    ASSERT_FALSE(manager.get_should_stop());
+    ASSERT_TRUE(manager.get_should_start_new_iteration());
+    manager.set_should_stop(true);  // As the stop command does.
+    ASSERT_TRUE(manager.get_should_stop());
+    manager.stop_and_join();
+}
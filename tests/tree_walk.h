@@ -0,0 +1,42 @@
+// Copyright 2025 Filip Agert
+#ifndef TREE_WALK_H
+#define TREE_WALK_H
+#include <array>
+#include <board.h>
+#include <constants.h>
+#include <cstddef>
+#include <gtest/gtest.h>
+#include <movegen.h>
+#include <type_traits>
+
+/**
+ * @brief Visits every position up to depth plies from board, board itself included, and calls
+ * check(board, is_white) on each. Moves are made with do_move and taken back with undo_move. Stops
+ * at the first failed assertion.
+ *
+ * @tparam is_white side to move in board.
+ * @param[in] check callable taking the board and the side to move as std::bool_constant, so it can
+ * be used as a template argument.
+ */
+template <bool is_white, typename Check> void for_each_node(Board &board, int depth, Check &check) {
+    check(board, std::bool_constant<is_white>{});
+    if (depth == 0 || ::testing::Test::HasFatalFailure())
+        return;
+    std::array<Move, max_legal_moves> moves;
+    size_t num_moves = board.get_moves<normal_search, is_white>(moves);
+    for (size_t i = 0; i < num_moves && !::testing::Test::HasFatalFailure(); i++) {
+        restore_move_info info = board.do_move<is_white>(moves[i]);
+        for_each_node<!is_white>(board, depth - 1, check);
+        board.undo_move<is_white>(info, moves[i]);
+    }
+}
+/**
+ * @brief Same as above, for whichever side is to move in board.
+ */
+template <typename Check> void for_each_node(Board &board, int depth, Check check) {
+    if (board.get_turn_color() == pieces::white)
+        for_each_node<true>(board, depth, check);
+    else
+        for_each_node<false>(board, depth, check);
+}
+#endif